@@ -49,23 +49,24 @@ void
     c64->debug(2, "Execution thread started\n");
     c64->putMessage(MSG_RUN);
     
-    // Configure thread properties...
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    pthread_cleanup_push(threadCleanup, thisC64);
-    
     // Prepare to run...
     c64->cpu.clearErrorState();
     c64->drive1.cpu.clearErrorState();
     c64->drive2.cpu.clearErrorState();
     c64->restartTimer();
     
-    while (likely(success)) {
-        pthread_testcancel();
+    // Frames are never interrupted. The thread only pauses or terminates
+    // in between two frames (including the run-ahead frames).
+    while (likely(success) && c64->waitWhileSuspended()) {
         success = c64->executeOneFrame();
+        
+        // Compute the future frames
+        if (success && c64->getRunAhead()) {
+            c64->executeRunAheadFrames();
+        }
     }
     
-    pthread_cleanup_pop(1);
+    threadCleanup(thisC64);
     pthread_exit(NULL);    
 }
 
@@ -83,6 +84,7 @@ C64::C64()
     warp = false;
     alwaysWarp = false;
     warpLoad = false;
+    fastTapeLoad = false;
     
     // Register sub components
     VirtualComponent *subcomponents[] = {
@@ -127,8 +129,13 @@ C64::C64()
     drive1.powerOn();
     drive2.powerOff();
     
+    // Initialize thread synchronization primitives
+    pthread_mutex_init(&threadLock, NULL);
+    pthread_cond_init(&threadCond, NULL);
+    
     // Initialize mach timer info
     mach_timebase_info(&timebase);
+    clearRunAheadInfo();
 
     reset();
 }
@@ -138,6 +145,12 @@ C64::~C64()
     debug(1, "Destroying virtual C64[%p]\n", this);
     
     halt();
+    
+    pthread_cond_destroy(&threadCond);
+    pthread_mutex_destroy(&threadLock);
+    
+    if (runAheadState)
+        delete[] runAheadState;
 }
 
 void
@@ -183,25 +196,67 @@ C64::setClockFrequency(uint32_t value)
 void
 C64::suspend()
 {
-    debug(2, "Suspending...(%d)\n", suspendCounter);
+    debug(2, "Suspending...(%d)\n", suspendCounter.load());
     
     if (suspendCounter == 0 && isHalted())
     return;
     
-    halt();
+    pthread_mutex_lock(&threadLock);
     suspendCounter++;
+    
+    // Nothing to wait for if we are called from inside the execution thread
+    if (!pthread_equal(p, pthread_self())) {
+        
+        // Ask the execution thread to pause and wait until it has done so.
+        // Every caller waits, even if the thread has been suspended already
+        // by another one.
+        pauseRequested = true;
+        while (!paused && isRunning())
+            pthread_cond_wait(&threadCond, &threadLock);
+    }
+    pthread_mutex_unlock(&threadLock);
 }
 
 void
 C64::resume()
 {
-    debug(2, "Resuming (%d)...\n", suspendCounter);
+    debug(2, "Resuming (%d)...\n", suspendCounter.load());
     
-    if (suspendCounter == 0)
-    return;
+    pthread_mutex_lock(&threadLock);
+    if (suspendCounter > 0 && --suspendCounter == 0) {
+        
+        // Let the execution thread continue
+        pauseRequested = false;
+        pthread_cond_broadcast(&threadCond);
+    }
+    pthread_mutex_unlock(&threadLock);
+}
+
+bool
+C64::waitWhileSuspended()
+{
+    bool slept = false;
     
-    if (--suspendCounter == 0)
-    run();
+    pthread_mutex_lock(&threadLock);
+    if (pauseRequested && !stopRequested) {
+        
+        // Signal suspend() that we have reached a frame boundary
+        paused = slept = true;
+        pthread_cond_broadcast(&threadCond);
+        
+        // Sleep until resume() or halt() is called
+        while (pauseRequested && !stopRequested)
+            pthread_cond_wait(&threadCond, &threadLock);
+        paused = false;
+    }
+    bool result = !stopRequested;
+    pthread_mutex_unlock(&threadLock);
+    
+    // Don't try to catch up with the time we have been sleeping
+    if (slept)
+        restartTimer();
+    
+    return result;
 }
 
 void 
@@ -218,6 +273,14 @@ C64::dump() {
     msg("  Current rasterline cycle : %d\n", rasterCycle);
     msg("              Ultimax mode : %s\n\n", getUltimax() ? "YES" : "NO");
     msg("warp, warpLoad, alwaysWarp : %d %d %d\n", warp, warpLoad, alwaysWarp);
+    msg("                 Run-ahead : %d frames\n", runAhead);
+    if (runAheadInfo.frames) {
+        uint64_t n = runAheadInfo.frames;
+        msg("           Saving snapshot : %llu usec (avg)\n", runAheadInfo.saveTime / n / 1000);
+        msg("   Emulating future frames : %llu usec (avg)\n", runAheadInfo.emulateTime / n / 1000);
+        msg("        Restoring snapshot : %llu usec (avg)\n", runAheadInfo.restoreTime / n / 1000);
+        msg("        Overhead per frame : %llu usec (max)\n", runAheadInfo.maxOverhead / 1000);
+    }
     msg("\n");
 }
 
@@ -399,10 +462,20 @@ C64::halt()
 {
     if (isRunning()) {
         
-        // Cancel execution thread
-        pthread_cancel(p);
+        pthread_t thread = p;
+        
+        // Ask the execution thread to terminate
+        pthread_mutex_lock(&threadLock);
+        stopRequested = true;
+        pthread_cond_broadcast(&threadCond);
+        pthread_mutex_unlock(&threadLock);
+        
+        // The thread can't wait for itself. It terminates after this frame.
+        if (pthread_equal(thread, pthread_self()))
+        return;
+        
         // Wait until thread terminates
-        pthread_join(p, NULL);
+        pthread_join(thread, NULL);
         // Finish the current command (to reach a clean state)
         step();
     }
@@ -411,7 +484,11 @@ C64::halt()
 void
 C64::threadCleanup()
 {
+    pthread_mutex_lock(&threadLock);
     p = NULL;
+    stopRequested = false;
+    pthread_cond_broadcast(&threadCond);
+    pthread_mutex_unlock(&threadLock);
     debug(2, "Execution thread cleanup\n");
 }
 
@@ -550,7 +627,7 @@ C64::_executeOneCycle()
     if (drive1.isPoweredOn()) result &= drive1.execute(durationOfOneCycle);
     if (drive2.isPoweredOn()) result &= drive2.execute(durationOfOneCycle);
     // if (iec.isDirtyDriveSide) iec.updateIecLinesDriveSide();
-    datasette.execute();
+    if (cycle >= datasette.wakeUpCycle) datasette.execute();
     
     rasterCycle++;
     return result;
@@ -573,6 +650,11 @@ C64::endRasterLine()
     rasterCycle = 1;
     rasterLine++;
     
+    if (fingerprintInterval && cpu.cycle >= nextFingerprint && !runningAhead) {
+        fingerprintTrace.record(getFingerprint());
+        nextFingerprint += fingerprintInterval;
+    }
+    
     if (rasterLine >= vic.getRasterlinesPerFrame()) {
         rasterLine = 0;
         endFrame();
@@ -590,11 +672,19 @@ C64::endFrame()
     cia2.incrementTOD();
     
     // Execute remaining SID cycles
-    sid.executeUntil(cpu.cycle);
+    sid.endFrame();
     
     // Execute other components
     iec.execute();
     expansionport.execute();
+    
+    // Skip the rest if this is a frame that will be rolled back. The state
+    // of the control ports and the mouse is not part of the snapshot and
+    // would survive the rollback.
+    if (runningAhead)
+        return;
+    
+    // Update the autofire state
     port1.execute();
     port2.execute();
 
@@ -635,7 +725,6 @@ C64::getWarp()
         } else {
             // Smoothly fade in SID
             sid.rampUp();
-            sid.alignWritePtr();
             restartTimer();
         }
         
@@ -661,6 +750,106 @@ C64::setWarpLoad(bool b)
     warpLoad = b;
 }
 
+void
+C64::setFastTapeLoad(bool b)
+{
+    suspend();
+    fastTapeLoad = b;
+    if (b) {
+        cpu.setKernalTrap(KERNAL_TAPE_LOAD);
+    } else {
+        cpu.deleteKernalTrap(KERNAL_TAPE_LOAD);
+    }
+    resume();
+}
+
+void
+C64::setRunAhead(unsigned frames)
+{
+    suspend();
+    
+    runAhead = frames;
+    vic.setPresentFrames(runAhead == 0);
+    clearRunAheadInfo();
+    
+    if (runAhead == 0 && runAheadState) {
+        delete[] runAheadState;
+        runAheadState = NULL;
+        runAheadStateCapacity = 0;
+    }
+    
+    resume();
+}
+
+void
+C64::executeRunAheadFrames()
+{
+    uint8_t *ptr;
+    uint8_t keyMatrix[32];
+    uint64_t t0, t1, t2, t3;
+    
+    // Running ahead makes no sense if we don't synchronize with the host
+    if (warp) {
+        vic.setPresentFrames(true);
+        return;
+    }
+    
+    // Make sure that the state storage is big enough
+    size_t size = stateSize();
+    if (size > runAheadStateCapacity) {
+        delete[] runAheadState;
+        runAheadState = new uint8_t[size];
+        runAheadStateCapacity = size;
+    }
+    
+    // Save the current state
+    t0 = mach_absolute_time();
+    ptr = runAheadState;
+    saveToBuffer(&ptr);
+    
+    // Emulate the future frames and present the last one
+    t1 = mach_absolute_time();
+    runningAhead = true;
+    for (unsigned i = 1; i <= runAhead; i++) {
+        
+        vic.setPresentFrames(i == runAhead);
+        if (!executeOneFrame()) {
+            
+            // A breakpoint has been reached in the future. Soft breakpoints
+            // delete themselves when reached, so we need to reinstall them.
+            CPU *cpus[] = { &cpu, &drive1.cpu, &drive2.cpu };
+            for (unsigned j = 0; j < 3; j++) {
+                if (cpus[j]->getErrorState() == CPU_SOFT_BREAKPOINT_REACHED)
+                    cpus[j]->setSoftBreakpoint(cpus[j]->getPC());
+            }
+            break;
+        }
+    }
+    vic.setPresentFrames(false);
+    
+    // Restore the saved state, but keep the live keyboard matrix. It may have
+    // been changed by the GUI while we were running ahead.
+    t2 = mach_absolute_time();
+    assert(keyboard.stateSize() <= sizeof(keyMatrix));
+    ptr = keyMatrix;
+    keyboard.saveToBuffer(&ptr);
+    ptr = runAheadState;
+    loadFromBuffer(&ptr);
+    ptr = keyMatrix;
+    keyboard.loadFromBuffer(&ptr);
+    runningAhead = false;
+    t3 = mach_absolute_time();
+    
+    // Record timing information
+    uint64_t overhead = abs_to_nanos(t3 - t0);
+    runAheadInfo.frames++;
+    runAheadInfo.stateSize = size;
+    runAheadInfo.saveTime += abs_to_nanos(t1 - t0);
+    runAheadInfo.emulateTime += abs_to_nanos(t2 - t1);
+    runAheadInfo.restoreTime += abs_to_nanos(t3 - t2);
+    runAheadInfo.maxOverhead = MAX(runAheadInfo.maxOverhead, overhead);
+}
+
 void
 C64::restartTimer()
 {
@@ -678,6 +867,12 @@ C64::synchronizeTiming()
     // Get current time in nano seconds
     uint64_t nanoAbsTime = abs_to_nanos(mach_absolute_time());
     
+    // Don't delay a pending suspend() or halt()
+    if (pauseRequested || stopRequested) {
+        nanoTargetTime += vic.getFrameDelay();
+        return;
+    }
+    
     // Check how long we're supposed to sleep
     int64_t timediff = (int64_t)nanoTargetTime - (int64_t)nanoAbsTime;
     if (timediff > 200000000 || timediff < -200000000 /* 0.2 sec */) {
@@ -779,6 +974,211 @@ C64::deleteSnapshot(vector<Snapshot *> &storage, unsigned index)
     }
 }
 
+C64 *
+C64::clone()
+{
+    debug(2, "Cloning C64[%p]\n", this);
+    
+    suspend();
+    
+    C64 *c = new C64();
+    
+    // Apply all settings that are not covered by a snapshot
+    c->vic.setModel(vic.getModel());
+    c->vic.setVideoPalette(vic.videoPalette());
+    c->vic.setBrightness(vic.getBrightness());
+    c->vic.setContrast(vic.getContrast());
+    c->vic.setSaturation(vic.getSaturation());
+    c->sid.setReSID(sid.getReSID());
+    c->sid.setModel(sid.getModel());
+    c->sid.setAudioFilter(sid.getAudioFilter());
+    c->sid.setSamplingMethod(sid.getSamplingMethod());
+    c->sid.setSampleRate(sid.getSampleRate());
+    c->mouse.setModel(mouse.getModel());
+    c->mouse.connectMouse(mouse.getPort());
+    c->setAlwaysWarp(alwaysWarp);
+    c->setWarpLoad(warpLoad);
+    c->setFastTapeLoad(fastTapeLoad);
+    c->setTakeAutoSnapshots(takeAutoSnapshots);
+    c->setSnapshotInterval(autoSnapshotInterval);
+    c->setRunAhead(runAhead);
+    
+    // Let the clone reference our immutable tape data. Loading the state
+    // keeps the shared tape, because its contents match. Cartridge Roms are
+    // shared automatically (the state refers to them by hash).
+    c->datasette.shareTape(&datasette);
+    
+    // Transfer the current state
+    size_t size = stateSize();
+    uint8_t *buffer = new uint8_t[size];
+    uint8_t *ptr = buffer;
+    saveToBuffer(&ptr);
+    ptr = buffer;
+    c->loadFromBuffer(&ptr);
+    assert((size_t)(ptr - buffer) == size);
+    delete[] buffer;
+    
+    resume();
+    return c;
+}
+
+bool
+C64::renderAudio(const char *filename, double seconds, uint32_t sampleRate)
+{
+    assert(filename != NULL);
+    
+    if (isRunning()) {
+        warn("Cannot render audio while the emulator is running.\n");
+        return false;
+    }
+    
+    WAVWriter wav;
+    if (!wav.open(filename, sampleRate)) {
+        return false;
+    }
+    
+    debug(2, "Rendering %.2f seconds of audio into %s\n", seconds, filename);
+    
+    // Remember the settings we are going to change
+    uint32_t oldSampleRate = sid.getSampleRate();
+    bool oldAlwaysWarp = alwaysWarp;
+    
+    sid.setSampleRate(sampleRate);
+    setAlwaysWarp(true);
+    sid.setRecorder(&wav);
+    
+    // Emulate whole rasterlines and finish with single cycles to stop
+    // exactly at the target cycle
+    uint64_t target = cpu.cycle + (uint64_t)(seconds * vic.getClockFrequency());
+    bool success = true;
+    while (success && cpu.cycle + vic.getCyclesPerRasterline() <= target) {
+        success = executeOneLine();
+    }
+    while (success && cpu.cycle < target) {
+        success = executeOneCycle();
+    }
+    
+    sid.setRecorder(NULL);
+    setAlwaysWarp(oldAlwaysWarp);
+    sid.setSampleRate(oldSampleRate);
+    
+    debug(2, "%lld samples written\n", wav.count());
+    return wav.close() && success;
+}
+
+StateFingerprint
+C64::getFingerprint()
+{
+    StateFingerprint result;
+    
+    result.frame = frame;
+    result.cycle = cpu.cycle;
+    result.component[FP_CPU] = cpu.fingerprint();
+    result.component[FP_CIA1] = cia1.fingerprint();
+    result.component[FP_CIA2] = cia2.fingerprint();
+    result.component[FP_VIC] = vic.fingerprint();
+    result.component[FP_SID] = sid.fingerprint();
+    result.component[FP_MEMORY] = mem.fingerprint();
+    result.component[FP_DRIVE1] = drive1.fingerprint();
+    result.component[FP_DRIVE2] = drive2.fingerprint();
+    
+    result.hash = fnv_1a_init64();
+    for (unsigned i = 0; i < FP_COUNT; i++) {
+        result.hash = fnv_1a_it64(result.hash, result.component[i]);
+    }
+    
+    return result;
+}
+
+void
+C64::setFingerprintInterval(uint64_t cycles)
+{
+    suspend();
+    fingerprintInterval = cycles;
+    nextFingerprint = cpu.cycle + cycles;
+    fingerprintTrace.clear();
+    resume();
+}
+
+bool
+C64::replay(C64 *other, unsigned frames, DivergenceInfo *info)
+{
+    assert(other != NULL && other != this);
+    assert(info != NULL);
+    assert(!isRunning() && !other->isRunning());
+    
+    memset(info, 0, sizeof(DivergenceInfo));
+    info->index = -1;
+    
+    if (cpu.cycle != other->cpu.cycle || rasterCycle != other->rasterCycle) {
+        warn("Cannot replay. Both instances must start at the same cycle.\n");
+        return false;
+    }
+    
+    C64 *instance[2] = { this, other };
+    uint8_t *state[2] = { NULL, NULL };
+    size_t capacity[2] = { 0, 0 };
+    
+    for (unsigned i = 0; i < frames; i++) {
+        
+        // Remember the state at the beginning of the frame
+        uint64_t start = cpu.cycle;
+        for (unsigned k = 0; k < 2; k++) {
+            size_t size = instance[k]->stateSize();
+            if (size > capacity[k]) {
+                delete[] state[k];
+                state[k] = new uint8_t[size];
+                capacity[k] = size;
+            }
+            uint8_t *ptr = state[k];
+            instance[k]->saveToBuffer(&ptr);
+        }
+        
+        // Execute the frame
+        bool ok1 = executeOneFrame();
+        bool ok2 = other->executeOneFrame();
+        uint64_t end = cpu.cycle;
+        StateFingerprint fp1 = getFingerprint();
+        StateFingerprint fp2 = other->getFingerprint();
+        
+        if (fp1.hash == fp2.hash && end == other->cpu.cycle) {
+            if (ok1 && ok2) continue;
+            debug("Replay stopped by a breakpoint in frame %lld\n", fp1.frame);
+            break;
+        }
+        
+        // Roll back and replay the frame cycle by cycle
+        for (unsigned k = 0; k < 2; k++) {
+            uint8_t *ptr = state[k];
+            instance[k]->loadFromBuffer(&ptr);
+        }
+        uint64_t lastMatchingCycle = start;
+        while (cpu.cycle < end) {
+            executeOneCycle();
+            other->executeOneCycle();
+            fp1 = getFingerprint();
+            fp2 = other->getFingerprint();
+            if (fp1.hash != fp2.hash) break;
+            lastMatchingCycle = cpu.cycle;
+        }
+        
+        info->diverged = true;
+        info->index = (long)i;
+        info->frame = fp1.frame;
+        info->cycle = fp1.cycle;
+        info->lastMatchingCycle = lastMatchingCycle;
+        for (unsigned j = 0; j < FP_COUNT; j++) {
+            if (fp1.component[j] != fp2.component[j])
+                info->components |= 1 << j;
+        }
+        break;
+    }
+    
+    delete[] state[0];
+    delete[] state[1];
+    return info->diverged;
+}
+
 bool
 C64::flash(AnyC64File *file)
 {
@@ -830,6 +1230,7 @@ C64::flash(AnyArchive *file, unsigned item)
         case P00_FILE:
         file->selectItem(item);
         file->flashItem(mem.ram);
+        mem.markRamAsDirty();
         break;
         
         default:
@@ -840,6 +1241,23 @@ C64::flash(AnyArchive *file, unsigned item)
     return result;
 }
 
+bool
+C64::executeKernalTrap(uint16_t addr)
+{
+    // Only trap the original Kernal routines
+    if (mem.getPeekSource(addr) != M_KERNAL)
+        return false;
+    
+    switch (addr) {
+            
+        case KERNAL_TAPE_LOAD:
+            return fastTapeLoad && datasette.fastLoad();
+            
+        default:
+            return false;
+    }
+}
+
 bool
 C64::loadRom(const char *filename)
 {
@@ -25,11 +25,14 @@
 // Configuration items
 #include "Configure.h"
 
+#include <atomic>
+
 // Data types and constants
 #include "C64_types.h"
 
 // General
 #include "MessageQueue.h"
+#include "FingerprintTrace.h"
 
 // Loading and saving
 #include "Snapshot.h"
@@ -54,6 +57,7 @@
 #include "DriveMemory.h"
 #include "VIC.h"
 #include "SIDBridge.h"
+#include "AudioMixer.h"
 #include "TOD.h"
 #include "CIA.h"
 #include "CPU.h"
@@ -122,10 +126,10 @@ class C64 : public VirtualComponent {
     IEC iec;
 
     //! @brief    A VC1541 floppy drive (with device number 8)
-    VC1541 drive1 = VC1541(1);
+    VC1541 drive1 { 1 };
     
     //! @brief    A second VC1541 floppy drive (with device number 9)
-    VC1541 drive2 = VC1541(2);
+    VC1541 drive2 { 2 };
     
     //! @brief    A Commodore 1530 (C2N) Datasette
     Datasette datasette;
@@ -179,8 +183,11 @@ class C64 : public VirtualComponent {
     // Execution thread
     //
     
-    //! @brief    An invocation counter for implementing suspend() / resume()
-    unsigned suspendCounter = 0;
+    /*! @brief    An invocation counter for implementing suspend() / resume()
+     *  @details  suspend() and resume() are called from multiple threads.
+     *            The counter is modified under threadLock.
+     */
+    std::atomic<unsigned> suspendCounter { 0 };
     
     /*! @brief    The emulators execution thread
      *  @details  The thread is created when the emulator is started and
@@ -190,6 +197,28 @@ class C64 : public VirtualComponent {
     
     private:
     
+    /*! @brief    Mutex protecting the thread control flags below
+     *  @details  suspend(), resume() and halt() don't cancel the execution
+     *            thread. They set a request flag and wait on threadCond until
+     *            the thread has reached the next frame boundary.
+     */
+    pthread_mutex_t threadLock;
+    
+    //! @brief    Condition variable for pausing and waking up the thread
+    pthread_cond_t threadCond;
+    
+    /*! @brief    Set by suspend() to ask the execution thread to pause
+     *  @details  The flag is written under threadLock, but polled without it
+     *            by synchronizeTiming(). Hence, it is atomic.
+     */
+    std::atomic<bool> pauseRequested { false };
+    
+    //! @brief    Indicates that the execution thread sleeps in suspension
+    bool paused = false;
+    
+    //! @brief    Set by halt() to ask the execution thread to terminate
+    std::atomic<bool> stopRequested { false };
+    
     /*! @brief    System timer information
      *  @details  Used to put the emulation thread to sleep for the proper
      *            amount of time.
@@ -215,6 +244,54 @@ class C64 : public VirtualComponent {
      */
     bool warpLoad;
     
+    /*! @brief    Indicates that standard tapes should be loaded instantly
+     *  @details  If set, the Kernal's tape load routine is trapped.
+     *  @see      Datasette::fastLoad()
+     */
+    bool fastTapeLoad;
+    
+    
+    //
+    // Run-ahead
+    //
+    
+    /*! @brief    Number of frames to run ahead
+     *  @details  If this value is greater than 0, the emulator computes
+     *            runAhead future frames after each emulated frame, displays
+     *            the last one, and rolls back to the saved state afterwards.
+     *            This hides the input lag caused by the frame-based input
+     *            sampling.
+     */
+    unsigned runAhead = 0;
+    
+    //! @brief    Indicates that a future frame is currently being computed.
+    bool runningAhead = false;
+    
+    //! @brief    Storage for the emulator state that is restored after running ahead
+    uint8_t *runAheadState = NULL;
+    
+    //! @brief    Capacity of runAheadState in bytes
+    size_t runAheadStateCapacity = 0;
+    
+    //! @brief    Timing statistics of the run-ahead feature
+    RunAheadInfo runAheadInfo;
+    
+    
+    //
+    // State fingerprints
+    //
+    
+    /*! @brief    Number of CPU cycles between two recorded fingerprints
+     *  @details  A value of 0 disables recording.
+     */
+    uint64_t fingerprintInterval = 0;
+    
+    //! @brief    CPU cycle at which the next fingerprint will be recorded
+    uint64_t nextFingerprint = 0;
+    
+    //! @brief    Recorded fingerprints
+    FingerprintTrace fingerprintTrace;
+    
     
     //
     // Operation modes
@@ -327,8 +404,12 @@ class C64 : public VirtualComponent {
     //! @brief    Gets a notification message from message queue
     Message getMessage() { return queue.getMessage(); }
     
-    //! @brief    Feeds a notification message into message queue
-    void putMessage(MessageType msg, uint64_t data = 0) { queue.putMessage(msg, data); }
+    /*! @brief    Feeds a notification message into message queue
+     *  @note     Messages are discarded while the emulator runs ahead, because
+     *            they would refer to frames that get rolled back.
+     */
+    void putMessage(MessageType msg, uint64_t data = 0) {
+        if (!runningAhead) queue.putMessage(msg, data); }
     
     
     //
@@ -351,12 +432,22 @@ class C64 : public VirtualComponent {
     void run();
     
     /*! @brief    Stops the emulation execution thread.
-     *  @details  The execution thread is canceled, but the internal state
-     *            remains intact. Emulation can be continued by a call to run().
-     *            Calling this functions has no effect, if the emulator is
-     *            not running.
+     *  @details  The execution thread terminates at the next frame boundary,
+     *            but the internal state remains intact. Emulation can be
+     *            continued by a call to run(). Calling this functions has no
+     *            effect, if the emulator is not running.
      */
     void halt();
+    
+    /*! @brief    Pauses the execution thread while a suspension is pending.
+     *  @details  This method is called by the execution thread in between
+     *            two frames. If suspend() has been called, the thread sleeps
+     *            until resume() or halt() is called. suspend() and resume()
+     *            therefore keep the thread alive and are much cheaper than a
+     *            halt() / run() pair.
+     *  @return   false if the thread is supposed to terminate.
+     */
+    bool waitWhileSuspended();
         
     /*! @brief    The tread exit function.
      *  @details  This method is invoked automatically when the emulator thread
@@ -437,6 +528,9 @@ class C64 : public VirtualComponent {
      */
     bool getWarp();
     
+    //! @brief    Returns the value of variable warp without updating it.
+    bool isWarping() { return warp; }
+    
     //! @brief    Returns if the emulator should always run full speed.
     bool getAlwaysWarp() { return alwaysWarp; }
     
@@ -449,6 +543,39 @@ class C64 : public VirtualComponent {
     //! @brief    Setter for warpLoad
     void setWarpLoad(bool b);
     
+    //! @brief    Returns if standard tapes are loaded instantly.
+    bool getFastTapeLoad() { return fastTapeLoad; }
+    
+    //! @brief    Setter for fastTapeLoad
+    void setFastTapeLoad(bool b);
+    
+    //! @brief    Returns the number of frames the emulator runs ahead.
+    unsigned getRunAhead() { return runAhead; }
+    
+    /*! @brief    Sets the number of frames the emulator runs ahead.
+     *  @details  A value of 0 disables the run-ahead feature.
+     */
+    void setRunAhead(unsigned frames);
+    
+    //! @brief    Indicates if the emulator is computing a future frame.
+    bool isRunningAhead() { return runningAhead; }
+    
+    //! @brief    Returns the timing statistics of the run-ahead feature.
+    RunAheadInfo getRunAheadInfo() { return runAheadInfo; }
+    
+    //! @brief    Resets the timing statistics of the run-ahead feature.
+    void clearRunAheadInfo() { memset(&runAheadInfo, 0, sizeof(runAheadInfo)); }
+    
+    /*! @brief    Computes and displays a future frame.
+     *  @details  This function is called by the execution thread after each
+     *            frame if the run-ahead feature is enabled. It saves the
+     *            current state, emulates runAhead frames with the current
+     *            input, leaves the last frame in the screen buffer, and
+     *            restores the saved state. Audio samples and GUI messages
+     *            produced in the future frames are discarded.
+     */
+    void executeRunAheadFrames();
+    
     /*! @brief    Restarts the synchronization timer.
      *  @details  The function is invoked at launch time to initialize the timer
      *            and reinvoked when the synchronization timer gets out of sync.
@@ -542,6 +669,49 @@ class C64 : public VirtualComponent {
     void deleteAutoSnapshot(unsigned nr) { deleteSnapshot(autoSnapshots, nr); }
     void deleteUserSnapshot(unsigned nr) { deleteSnapshot(userSnapshots, nr); }
     
+    
+    //
+    //! @functiongroup Cloning
+    //
+    
+    /*! @brief    Creates an independent copy of this emulator instance.
+     *  @details  The clone starts in the exact state of this instance,
+     *            including inserted disks, the datasette tape, the attached
+     *            cartridge (including on-board RAM and flash memory) and all
+     *            configuration settings that are not part of a snapshot. The
+     *            state is transferred in memory without creating a snapshot
+     *            file. Immutable data (the tape image and the cartridge Rom
+     *            packets) is not copied, but shared with the clone. The
+     *            clone is halted and owns a separate message queue and
+     *            execution thread. Hence, it can be run concurrently with
+     *            this instance.
+     *  @note     It is safe to call this function on a running emulator.
+     *            The caller is responsible for deleting the returned object.
+     */
+    C64 *clone();
+    
+    
+    //
+    //! @functiongroup Rendering audio
+    //
+    
+    /*! @brief    Emulates a period of time and saves the audio output.
+     *  @details  The emulator runs in warp mode for the specified duration.
+     *            All sound samples produced by SID are written into a 16 bit
+     *            mono WAV file. They bypass the audio ringbuffer. Hence, the
+     *            sample rate is not adjusted to the consumer. The sample rate
+     *            and the warp setting are restored afterwards. This function
+     *            runs on the calling thread. Hence, multiple instances can
+     *            render concurrently.
+     *  @note     The emulator needs to be halted.
+     *  @param    filename Name of the WAV file to create
+     *  @param    seconds Duration of the emulated time period
+     *  @param    sampleRate Sample rate of the WAV file
+     *  @return   false if the file cannot be written or emulation has stopped
+     *            before the time period has elapsed (e.g., on a breakpoint).
+     */
+    bool renderAudio(const char *filename, double seconds, uint32_t sampleRate = 44100);
+    
 
     //
     //! @functiongroup Handling Roms
@@ -551,6 +721,50 @@ class C64 : public VirtualComponent {
     bool loadRom(const char *filename);
 
     
+    //
+    //! @functiongroup Fingerprinting the machine state
+    //
+    
+    /*! @brief    Computes a fingerprint of the current machine state.
+     *  @details  The fingerprint comprises hash values for the CPU, both CIAs,
+     *            VICII, SID, RAM, and both drives. The RAM hash is updated
+     *            incrementally. Hence, calling this function every frame is
+     *            cheap.
+     */
+    StateFingerprint getFingerprint();
+    
+    //! @brief    Returns the fingerprint recording interval in CPU cycles.
+    uint64_t getFingerprintInterval() { return fingerprintInterval; }
+    
+    /*! @brief    Starts or stops recording fingerprints.
+     *  @details  If a value other than 0 is given, a fingerprint is recorded
+     *            whenever the specified number of CPU cycles has elapsed. The
+     *            check is performed at the end of each rasterline. Hence,
+     *            passing the number of cycles per frame records a fingerprint
+     *            in the same rasterline of each frame. The trace is cleared.
+     */
+    void setFingerprintInterval(uint64_t cycles);
+    
+    //! @brief    Returns the recorded fingerprints.
+    FingerprintTrace *getFingerprintTrace() { return &fingerprintTrace; }
+    
+    /*! @brief    Replays two emulator instances side by side.
+     *  @details  Both instances must be halted and must start at the same
+     *            cycle, e.g., because one of them has been created by
+     *            clone() or both have loaded the same snapshot. The instances
+     *            are executed frame by frame and their fingerprints are
+     *            compared at the end of each frame. On a mismatch, both
+     *            instances are rolled back to the beginning of the frame and
+     *            replayed cycle by cycle to find the first cycle with
+     *            diverging fingerprints. Both instances are left in the state
+     *            of that cycle.
+     *  @param    frames Maximum number of frames to replay
+     *  @return   true, if a divergence has been found.
+     *  @see      FingerprintTrace::dump()
+     */
+    bool replay(C64 *other, unsigned frames, DivergenceInfo *info);
+
+    
     //
     //! @functiongroup Flashing files
     //
@@ -561,6 +775,23 @@ class C64 : public VirtualComponent {
     //! @brief    Flashes a single item of an archive into memory
     bool flash(AnyArchive *file, unsigned item);
     
+    
+    //
+    //! @functiongroup Trapping Kernal routines
+    //
+    
+    //! @brief    Entry point of the Kernal's tape load routine
+    static const uint16_t KERNAL_TAPE_LOAD = 0xF539;
+    
+    /*! @brief    Executes a native replacement of a Kernal routine
+     *  @details  This function is called by the CPU when it fetches an
+     *            instruction from a memory cell tagged with KERNAL_TRAP.
+     *  @return   true, if the routine has been emulated. In this case, the
+     *            CPU continues at the return address of the routine. false,
+     *            if the routine needs to be executed by the CPU as usual.
+     */
+    bool executeKernalTrap(uint16_t addr);
+    
  
     //
     //! @functiongroup Set and query ultimax mode
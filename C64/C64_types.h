@@ -71,6 +71,61 @@ static const C64Configuration configurations[] = {
     { NTSC_6567_R56A, false, MOS_6526, false, MOS_6581, false, GLUE_DISCRETE, INIT_PATTERN_C64 }
 };
 
+/*! @brief    Run-ahead statistics
+ *  @details  Used by C64::getRunAheadInfo() to report the per-frame overhead
+ *            of the run-ahead feature. All times are given in nanoseconds.
+ */
+typedef struct {
+    uint64_t frames;
+    uint64_t stateSize;
+    uint64_t saveTime;
+    uint64_t emulateTime;
+    uint64_t restoreTime;
+    uint64_t maxOverhead;
+} RunAheadInfo;
+
+/*! @brief    Components covered by a state fingerprint
+ *  @see      StateFingerprint
+ */
+typedef enum {
+    FP_CPU = 0,
+    FP_CIA1,
+    FP_CIA2,
+    FP_VIC,
+    FP_SID,
+    FP_MEMORY,
+    FP_DRIVE1,
+    FP_DRIVE2,
+    FP_COUNT
+} FingerprintComponent;
+
+/*! @brief    Fingerprint of the machine state
+ *  @details  Used by C64::getFingerprint() to provide hash values for the
+ *            most important components and a combined hash value. Two
+ *            emulator instances that execute the same workload should produce
+ *            the same fingerprints at the same cycle.
+ */
+typedef struct {
+    uint64_t frame;
+    uint64_t cycle;
+    uint64_t component[FP_COUNT];
+    uint64_t hash;
+} StateFingerprint;
+
+/*! @brief    Result of comparing two fingerprint traces
+ *  @details  Used by FingerprintTrace::findDivergence(). The divergence
+ *            happened after the cycle of the previous record (or at power up)
+ *            and before or at the specified cycle.
+ */
+typedef struct {
+    bool diverged;
+    long index;
+    uint64_t frame;
+    uint64_t cycle;
+    uint64_t lastMatchingCycle;
+    uint32_t components;
+} DivergenceInfo;
+
 /*! @brief    Message types
  *  @details  List of all possible message id's
  */
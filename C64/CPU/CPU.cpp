@@ -28,9 +28,6 @@ CPU::CPU(CPUModel model, Memory *mem)
 	
     setDescription(model == MOS_6502 ? "CPU(6502)" : "CPU");
 	debug(3, "  Creating %s at address %p...\n", getDescription(), this);
-	
-    // Chip model
-    model = MOS_6510;
 
 	// Establish callback for each instruction
 	registerInstructions();
@@ -44,7 +41,7 @@ CPU::CPU(CPUModel model, Memory *mem)
     SnapshotItem items[] = {
         
         // Lifetime items
-        { &model,              sizeof(model),        KEEP_ON_RESET },
+        { &this->model,        sizeof(this->model),  KEEP_ON_RESET },
 
          // Internal state
         { &cycle,              sizeof(cycle),        CLEAR_ON_RESET },
@@ -583,6 +583,12 @@ class CPU : public VirtualComponent {
     
 	//! @brief    Sets or deletes a hard breakpoint at the specified address.
 	void toggleSoftBreakpoint(uint16_t addr) { breakpoint[addr] ^= SOFT_BREAKPOINT; }
+
+    //! @brief    Installs a Kernal trap at the specified address.
+    void setKernalTrap(uint16_t addr) { breakpoint[addr] |= KERNAL_TRAP; }
+
+    //! @brief    Removes a Kernal trap from the specified address.
+    void deleteKernalTrap(uint16_t addr) { breakpoint[addr] &= ~KERNAL_TRAP; }
     
     
     //
@@ -528,14 +528,21 @@ CPU::executeOneCycle()
             
             // Check breakpoint tag
             if (unlikely(breakpoint[pc] != NO_BREAKPOINT)) {
+                if ((breakpoint[pc] & KERNAL_TRAP) && isC64CPU() &&
+                    c64->executeKernalTrap(pc)) {
+                    // The trap has emulated the routine and changed the PC
+                    next = fetch;
+                    return true;
+                }
                 if (breakpoint[pc] & SOFT_BREAKPOINT) {
                     // Soft breakpoints get deleted when reached
                     breakpoint[pc] &= ~SOFT_BREAKPOINT;
                     setErrorState(CPU_SOFT_BREAKPOINT_REACHED);
-                } else {
+                    debug(1, "Breakpoint reached\n");
+                } else if (breakpoint[pc] & HARD_BREAKPOINT) {
                     setErrorState(CPU_HARD_BREAKPOINT_REACHED);
+                    debug(1, "Breakpoint reached\n");
                 }
-                debug(1, "Breakpoint reached\n");
             }
             
             return errorState == CPU_OK;
@@ -55,11 +55,16 @@ typedef enum {
  *            following breakpoint types:
  *            HARD_BREAKPOINT : Execution is halted.
  *            SOFT_BREAKPOINT : Execution is halted and the tag is deleted.
+ *            In addition, a memory cell can be tagged with KERNAL_TRAP which
+ *            hands control over to a native replacement of a Kernal routine
+ *            (C64 CPU only). Execution continues normally if the replacement
+ *            declines to handle the call.
  */
 typedef enum {
     NO_BREAKPOINT   = 0x00,
     HARD_BREAKPOINT = 0x01,
-    SOFT_BREAKPOINT = 0x02
+    SOFT_BREAKPOINT = 0x02,
+    KERNAL_TRAP     = 0x04
 } Breakpoint;
 
 
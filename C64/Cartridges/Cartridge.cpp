@@ -60,6 +60,9 @@ Cartridge::~Cartridge()
 {
     debug("Releasing cartridge...\n");
     
+    // Release the Rom packets
+    dealloc();
+    
     // Deallocate RAM (if any)
     if (externalRam) {
         assert(ramCapacity > 0);
@@ -337,7 +340,7 @@ Cartridge::poke(uint16_t addr, uint8_t value)
         
     // Write to RAM if we don't run in Ultimax mode
     if (!c64->getUltimax()) {
-        c64->mem.ram[addr] = value;
+        c64->mem.pokeRam(addr, value);
     }
 }
 
@@ -400,7 +403,7 @@ Cartridge::loadChip(unsigned nr, CRTFile *c)
     switch (type) {
         
         case 0: // ROM
-        packet[nr] = new CartridgeRom(size, start, c->chipData(nr));
+        packet[nr] = new CartridgeRom(c->chipStorage(nr), size, start);
         break;
         
         case 1: // RAM
@@ -409,7 +412,7 @@ Cartridge::loadChip(unsigned nr, CRTFile *c)
         
         case 2: // Flash ROM
         warn("Chip %d is a Flash Rom. Creating a Rom instead.\n", nr);
-        packet[nr] = new CartridgeRom(size, start, c->chipData(nr));
+        packet[nr] = new CartridgeRom(c->chipStorage(nr), size, start);
         break;
         
         default:
@@ -420,6 +423,15 @@ Cartridge::loadChip(unsigned nr, CRTFile *c)
     numPackets++;
 }
 
+void
+Cartridge::collectRoms(std::vector<RomReference> &roms)
+{
+    for (unsigned i = 0; i < numPackets; i++) {
+        assert(packet[i] != NULL);
+        packet[i]->collectRoms(roms);
+    }
+}
+
 void
 Cartridge::bankInROML(unsigned nr, uint16_t size, uint16_t offset)
 {
@@ -504,4 +516,5 @@ Cartridge::resetWithoutDeletingRam()
     memcpy(ram, c64->mem.ram, 0x10000);
     c64->reset();
     memcpy(c64->mem.ram, ram, 0x10000);
+    c64->mem.markRamAsDirty();
 }
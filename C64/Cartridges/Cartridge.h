@@ -245,6 +245,13 @@ public:
     //! @brief    Reads in a chip packet from a CRT file
     virtual void loadChip(unsigned nr, CRTFile *c);
     
+    /*! @brief    Collects the immutable Rom data referenced by this cartridge
+     *  @details  The emulator state only contains the content hash of this
+     *            data. Snapshots use this function to keep the data alive.
+     *  @see      RomStore
+     */
+    virtual void collectRoms(std::vector<RomReference> &roms);
+    
     //! @brief    Banks in a rom chip into the ROML space
     void bankInROML(unsigned nr, uint16_t size, uint16_t offset);
     
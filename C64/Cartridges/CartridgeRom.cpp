@@ -20,6 +20,52 @@
 
 #include "CartridgeRom.h"
 
+std::map<std::pair<uint64_t, uint32_t>, std::weak_ptr<uint8_t>> RomStore::entries;
+pthread_mutex_t RomStore::lock = PTHREAD_MUTEX_INITIALIZER;
+
+RomReference
+RomStore::add(std::shared_ptr<uint8_t> data, uint32_t size)
+{
+    assert(data != NULL);
+    
+    RomReference ref;
+    ref.hash = fnv_1a_64(data.get(), size);
+    ref.size = size;
+    
+    pthread_mutex_lock(&lock);
+    
+    // Forget about released data
+    for (auto it = entries.begin(); it != entries.end(); ) {
+        it = it->second.expired() ? entries.erase(it) : std::next(it);
+    }
+    
+    // Reuse the registered data if it has the same contents
+    std::weak_ptr<uint8_t> &entry = entries[std::make_pair(ref.hash, size)];
+    ref.data = entry.lock();
+    if (ref.data == NULL || memcmp(ref.data.get(), data.get(), size) != 0) {
+        ref.data = data;
+        entry = data;
+    }
+    
+    pthread_mutex_unlock(&lock);
+    return ref;
+}
+
+std::shared_ptr<uint8_t>
+RomStore::lookup(uint64_t hash, uint32_t size)
+{
+    std::shared_ptr<uint8_t> result;
+    
+    pthread_mutex_lock(&lock);
+    auto it = entries.find(std::make_pair(hash, size));
+    if (it != entries.end()) {
+        result = it->second.lock();
+    }
+    pthread_mutex_unlock(&lock);
+    
+    return result;
+}
+
 CartridgeRom::CartridgeRom()
 {
     setDescription("CartridgeRom");
@@ -31,6 +77,7 @@ CartridgeRom::CartridgeRom()
         // Internal state
         { &size,        sizeof(size),        KEEP_ON_RESET },
         { &loadAddress, sizeof(loadAddress), KEEP_ON_RESET },
+        { &hash,        sizeof(hash),        KEEP_ON_RESET },
         { NULL,         0,                   0 }};
     
     registerSnapshotItems(items, sizeof(items));
@@ -44,41 +91,41 @@ CartridgeRom::CartridgeRom(uint8_t **buffer) : CartridgeRom()
 }
 */
 
-CartridgeRom::CartridgeRom(uint16_t size, uint16_t loadAddress, const uint8_t *buffer) : CartridgeRom()
+CartridgeRom::CartridgeRom(std::shared_ptr<uint8_t> data, uint16_t size, uint16_t loadAddress) : CartridgeRom()
 {
+    RomReference ref = RomStore::add(data, size);
+    
     this->size = size;
     this->loadAddress = loadAddress;
-    rom = new uint8_t[size];
-    if (buffer) {
-        memcpy(rom, buffer, size);
-    }
+    hash = ref.hash;
+    romStorage = ref.data;
+    rom = romStorage.get();
 }
 
 CartridgeRom::~CartridgeRom()
 {
     assert(rom != NULL);
-    delete[] rom;
-}
-
-size_t
-CartridgeRom::stateSize()
-{
-    return VirtualComponent::stateSize() + size;
 }
 
 void
 CartridgeRom::didLoadFromBuffer(uint8_t **buffer)
 {
-    if (rom) delete[] rom;
-    rom = new uint8_t[size];
+    // The snapshot only contains the content hash of the Rom data
+    romStorage = RomStore::lookup(hash, size);
     
-    readBlock(buffer, rom, size);
+    if (romStorage == NULL) {
+        warn("Rom data with hash %llX is not available.\n", hash);
+        romStorage.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+        memset(romStorage.get(), 0xFF, size);
+    }
+    rom = romStorage.get();
 }
 
 void
-CartridgeRom::didSaveToBuffer(uint8_t **buffer)
+CartridgeRom::collectRoms(std::vector<RomReference> &roms)
 {
-    writeBlock(buffer, rom, size);
+    RomReference ref = { hash, size, romStorage };
+    roms.push_back(ref);
 }
 
 bool
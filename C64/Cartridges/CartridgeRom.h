@@ -22,6 +22,57 @@
 #define _CARTRIDGEROM_INC
 
 #include "VirtualComponent.h"
+#include <memory>
+#include <vector>
+#include <map>
+#include <pthread.h>
+
+/*! @brief    Reference to a chunk of immutable Rom data
+ */
+typedef struct {
+    
+    //! @brief    Content hash (fnv_1a_64)
+    uint64_t hash;
+    
+    //! @brief    Size in bytes
+    uint32_t size;
+    
+    //! @brief    The Rom data
+    std::shared_ptr<uint8_t> data;
+    
+} RomReference;
+
+
+/*! @class    RomStore
+ *  @brief    Process wide registry of immutable Rom data
+ *  @details  Rom data taken from a CRT file is registered under its content
+ *            hash. The emulator state only records the hash of such data and
+ *            looks it up here when the state is restored. The store holds weak
+ *            references, only. The data is released as soon as the last Rom
+ *            chip or snapshot referencing it is gone.
+ */
+class RomStore {
+    
+    //! @brief    Registered Rom data, indexed by content hash and size
+    static std::map<std::pair<uint64_t, uint32_t>, std::weak_ptr<uint8_t>> entries;
+    
+    //! @brief    Mutex protecting the registry
+    static pthread_mutex_t lock;
+    
+    public:
+    
+    /*! @brief    Registers a chunk of Rom data
+     *  @details  If data with the same contents has been registered before and
+     *            is still alive, the reference points to the existing data.
+     */
+    static RomReference add(std::shared_ptr<uint8_t> data, uint32_t size);
+    
+    /*! @brief    Looks up Rom data by its content hash
+     *  @return   NULL, if the data is not (or no longer) available.
+     */
+    static std::shared_ptr<uint8_t> lookup(uint64_t hash, uint32_t size);
+};
+
 
 /*! @brief    This class implements a cartridge Rom chip 
  */
@@ -29,9 +80,22 @@ class CartridgeRom : public VirtualComponent {
     
     protected:
     
-    //! @brief    Rom data
+    /*! @brief    Rom data
+     *  @details  The data is not copied out of the CRT file. The buffer is
+     *            reference counted and shared with the CRT file, with cloned
+     *            emulator instances, and with snapshots.
+     *  @see      RomStore
+     */
+    std::shared_ptr<uint8_t> romStorage;
+    
+    //! @brief    Rom data (shortcut to romStorage.get())
     uint8_t *rom = NULL;
     
+    /*! @brief    Content hash of the Rom data
+     *  @details  Snapshots store this value instead of the Rom data.
+     */
+    uint64_t hash = 0;
+    
     public:
     
     //! @brief    Size in bytes
@@ -50,15 +114,20 @@ class CartridgeRom : public VirtualComponent {
     //! @brief    Constructor
     CartridgeRom();
     // CartridgeRom(uint8_t **buffer);
-    CartridgeRom(uint16_t _size, uint16_t _loadAddress, const uint8_t *buffer = NULL);
+    
+    /*! @brief    Constructor
+     *  @param    data Rom data (usually pointing into the buffer of a CRT file)
+     */
+    CartridgeRom(std::shared_ptr<uint8_t> data, uint16_t _size, uint16_t _loadAddress);
     
     //! @brief    Destructor
     ~CartridgeRom();
     
     //! @brief    Methods from VirtualComponent
-    size_t stateSize();
     void didLoadFromBuffer(uint8_t **buffer);
-    void didSaveToBuffer(uint8_t **buffer);
+    
+    //! @brief    Adds a reference to the Rom data to the provided list
+    void collectRoms(std::vector<RomReference> &roms);
     
     //! @brief    Returns true if this Rom chip maps to ROML, only.
     bool mapsToL();
@@ -107,7 +107,7 @@ EasyFlash::loadChip(unsigned nr, CRTFile *c)
     
     uint16_t chipSize = c->chipSize(nr);
     uint16_t chipAddr = c->chipAddr(nr);
-    uint8_t *chipData = c->chipData(nr);
+    std::shared_ptr<uint8_t> chipData = c->chipStorage(nr);
 
     if (nr == 0) {
         bank = 0;
@@ -147,6 +147,14 @@ EasyFlash::loadChip(unsigned nr, CRTFile *c)
     }
 }
 
+void
+EasyFlash::collectRoms(std::vector<RomReference> &roms)
+{
+    Cartridge::collectRoms(roms);
+    flashRomL.collectRoms(roms);
+    flashRomH.collectRoms(roms);
+}
+
 uint8_t
 EasyFlash::peek(uint16_t addr)
 {
@@ -65,6 +65,7 @@ public:
     
     void resetCartConfig();
     void loadChip(unsigned nr, CRTFile *c);
+    void collectRoms(std::vector<RomReference> &roms);
     uint8_t peek(uint16_t addr);
     void poke(uint16_t addr, uint8_t value);
     uint8_t peekIO1(uint16_t addr);
@@ -56,12 +56,15 @@ FlashRom::FlashRom()
     
     rom = new uint8_t[size];
     memset(rom, 0xFF, size);
+    memset(modified, 0, sizeof(modified));
+    memset(originalHash, 0, sizeof(originalHash));
     
     // Register snapshot items
     SnapshotItem items[] = {
         { &state,             sizeof(state),                KEEP_ON_RESET },
         { &baseState,         sizeof(baseState),            KEEP_ON_RESET },
-        { rom,                size,                         KEEP_ON_RESET },
+        { modified,           sizeof(modified),             KEEP_ON_RESET },
+        { originalHash,       sizeof(originalHash),         QWORD_ARRAY | KEEP_ON_RESET },
         { NULL,               0,                            0 }};
     
     registerSnapshotItems(items, sizeof(items));
@@ -74,10 +77,25 @@ FlashRom::~FlashRom()
 }
 
 void
-FlashRom::loadBank(unsigned bank, uint8_t *data)
+FlashRom::loadBank(unsigned bank, std::shared_ptr<uint8_t> data)
 {
+    assert(isBankNumber(bank));
     assert(data != NULL);
-    memcpy(rom + bank * 0x2000, data, 0x2000);
+    
+    original[bank] = RomStore::add(data, 0x2000);
+    originalHash[bank] = original[bank].hash;
+    modified[bank] = false;
+    memcpy(rom + bank * 0x2000, data.get(), 0x2000);
+}
+
+void
+FlashRom::collectRoms(std::vector<RomReference> &roms)
+{
+    for (unsigned bank = 0; bank < 64; bank++) {
+        if (original[bank].data != NULL && !modified[bank]) {
+            roms.push_back(original[bank]);
+        }
+    }
 }
 
 void
@@ -101,6 +119,59 @@ FlashRom::dump()
     msg("       rom: %p\n\n", rom);
 }
 
+size_t
+FlashRom::stateSize()
+{
+    size_t result = VirtualComponent::stateSize();
+    
+    // Modified banks are stored completely
+    for (unsigned bank = 0; bank < 64; bank++) {
+        if (modified[bank]) result += 0x2000;
+    }
+    
+    return result;
+}
+
+void
+FlashRom::didLoadFromBuffer(uint8_t **buffer)
+{
+    for (unsigned bank = 0; bank < 64; bank++) {
+        
+        uint8_t *ptr = rom + bank * 0x2000;
+        
+        if (modified[bank]) {
+            readBlock(buffer, ptr, 0x2000);
+            continue;
+        }
+        
+        // Unmodified banks are restored from the RomStore
+        if (originalHash[bank] == 0) {
+            original[bank] = RomReference();
+            memset(ptr, 0xFF, 0x2000);
+            continue;
+        }
+        if (original[bank].data == NULL || original[bank].hash != originalHash[bank]) {
+            original[bank].hash = originalHash[bank];
+            original[bank].size = 0x2000;
+            original[bank].data = RomStore::lookup(originalHash[bank], 0x2000);
+        }
+        if (original[bank].data == NULL) {
+            warn("Rom data of bank %d (hash %llX) is not available.\n", bank, originalHash[bank]);
+            memset(ptr, 0xFF, 0x2000);
+            continue;
+        }
+        memcpy(ptr, original[bank].data.get(), 0x2000);
+    }
+}
+
+void
+FlashRom::didSaveToBuffer(uint8_t **buffer)
+{
+    for (unsigned bank = 0; bank < 64; bank++) {
+        if (modified[bank]) writeBlock(buffer, rom + bank * 0x2000, 0x2000);
+    }
+}
+
 uint8_t
 FlashRom::peek(uint32_t addr)
 {
@@ -306,6 +377,7 @@ FlashRom::doByteProgram(uint32_t addr, uint8_t value)
 {
     assert(addr < size);
     
+    modified[addr / 0x2000] = true;
     rom[addr] &= value;
     return rom[addr] == value;
 }
@@ -315,6 +387,7 @@ FlashRom::doChipErase() {
     
     debug("Erasing chip ...\n");
     memset(rom, 0xFF, size);
+    memset(modified, 1, sizeof(modified));
 }
 
 void
@@ -324,4 +397,5 @@ FlashRom::doSectorErase(uint32_t addr)
     
     debug("Erasing sector %d ... %d\n", addr >> 4);
     memset(rom + (addr & 0x0000), 0xFF, sectorSize);
+    memset(modified + (addr & 0x0000) / 0x2000, 1, sectorSize / 0x2000);
 }
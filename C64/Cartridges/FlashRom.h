@@ -21,7 +21,7 @@
 #ifndef _FLASHROM_INC
 #define _FLASHROM_INC
 
-#include "VirtualComponent.h"
+#include "CartridgeRom.h"
 
 /*! @brief    This class implements a Flash Rom module of type Am29F040B
  *  @details  Flash Rom modules of this type are used, e.g., by the EasyFlash
@@ -69,6 +69,19 @@ class FlashRom : public VirtualComponent {
     //! @brief    Flash Rom data
     uint8_t *rom;
     
+    /*! @brief    Original contents of each bank
+     *  @details  Banks loaded from a CRT file reference the data in the
+     *            RomStore. Snapshots store the content hash of unmodified
+     *            banks and the full data of modified ones, only.
+     */
+    RomReference original[64];
+    
+    //! @brief    Indicates which banks differ from their original contents
+    bool modified[64];
+    
+    //! @brief    Content hash of the original bank contents (0 = erased)
+    uint64_t originalHash[64];
+    
     public:
     
     //
@@ -95,7 +108,10 @@ class FlashRom : public VirtualComponent {
     /*! @brief    Loads an 8 KB chunk of Rom data from a buffer.
      *  @details  This method is used when loading the contents from a CRT file.
      */
-    void loadBank(unsigned bank, uint8_t *data);
+    void loadBank(unsigned bank, std::shared_ptr<uint8_t> data);
+    
+    //! @brief    Adds references to the original bank contents to the list
+    void collectRoms(std::vector<RomReference> &roms);
     
     
     //
@@ -104,6 +120,9 @@ class FlashRom : public VirtualComponent {
     
     void reset();
     void dump();
+    size_t stateSize();
+    void didLoadFromBuffer(uint8_t **buffer);
+    void didSaveToBuffer(uint8_t **buffer);
     
     //
     //! @functiongroup Accessing Rom cells
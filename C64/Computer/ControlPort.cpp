@@ -60,6 +60,10 @@ ControlPort::reset()
 void
 ControlPort::didLoadFromBuffer(uint8_t **buffer)
 {
+    // Keep the live input when rolling back after a run-ahead
+    if (c64->isRunningAhead())
+        return;
+    
     // Discard any active joystick movements
     button = false;
     axisX = 0;
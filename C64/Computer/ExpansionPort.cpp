@@ -72,11 +72,11 @@ ExpansionPort::stateSize()
 void
 ExpansionPort::didLoadFromBuffer(uint8_t **buffer)
 {
-    // Delete old cartridge (if any)
-    if (cartridge != NULL) {
-        delete cartridge;
-        cartridge = NULL;
-    }
+    // Keep the old cartridge (if any) until the new one has been loaded. The
+    // snapshot refers to the Rom data by hash and the old cartridge may hold
+    // the last reference to it.
+    Cartridge *oldCartridge = cartridge;
+    cartridge = NULL;
     
     // Read cartridge type and cartridge (if any)
     CartridgeType cartridgeType = (CartridgeType)read16(buffer);
@@ -84,6 +84,8 @@ ExpansionPort::didLoadFromBuffer(uint8_t **buffer)
         cartridge = Cartridge::makeWithType(c64, cartridgeType);
         cartridge->loadFromBuffer(buffer);
     }
+    
+    delete oldCartridge;
 }
 
 void
@@ -185,7 +187,7 @@ ExpansionPort::poke(uint16_t addr, uint8_t value)
     if (cartridge) {
         cartridge->poke(addr, value);
     } else if (!c64->getUltimax()) {
-        c64->mem.ram[addr] = value;
+        c64->mem.pokeRam(addr, value);
     }
 }
 
@@ -353,3 +355,11 @@ ExpansionPort::detachCartridgeAndReset()
     c64->reset();
     resume();
 }
+
+void
+ExpansionPort::collectRoms(std::vector<RomReference> &roms)
+{
+    if (cartridge) {
+        cartridge->collectRoms(roms);
+    }
+}
@@ -180,6 +180,11 @@ public:
 
     //! @brief    Removes a cartridge from the expansion port and resets
     void detachCartridgeAndReset();
+    
+    /*! @brief    Collects the Rom data referenced by the attached cartridge
+     *  @see      Cartridge::collectRoms()
+     */
+    void collectRoms(std::vector<RomReference> &roms);
 
     //
     //! @functiongroup Operating cartridge buttons
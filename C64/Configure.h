@@ -24,8 +24,8 @@
 
 // Snapshot version number of this release
 #define V_MAJOR 3
-#define V_MINOR 3
-#define V_SUBMINOR 0
+#define V_MINOR 4
+#define V_SUBMINOR 2
 
 // Disable assertion checking (Uncomment in release build)
 // #define NDEBUG
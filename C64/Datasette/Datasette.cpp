@@ -20,6 +20,7 @@
  */
 
 #include "C64.h"
+#include <algorithm>
 
 Datasette::Datasette()
 {
@@ -40,6 +41,7 @@ Datasette::Datasette()
         { &headInSeconds,      sizeof(headInSeconds),     CLEAR_ON_RESET },
         { &nextRisingEdge,     sizeof(nextRisingEdge),    CLEAR_ON_RESET },
         { &nextFallingEdge,    sizeof(nextFallingEdge),   CLEAR_ON_RESET },
+        { &syncCycle,          sizeof(syncCycle),         CLEAR_ON_RESET },
         { &playKey,            sizeof(playKey),           CLEAR_ON_RESET },
         { &motor,              sizeof(motor),             CLEAR_ON_RESET },
         
@@ -51,9 +53,6 @@ Datasette::Datasette()
 Datasette::~Datasette()
 {
     debug(3, "Releasing Datasette...\n");
-
-    if (data)
-        delete[] data;
 }
 
 void
@@ -61,6 +60,7 @@ Datasette::reset()
 {
     VirtualComponent::reset();
     rewind();
+    scheduleNextEvent();
 }
 
 void
@@ -80,12 +80,29 @@ Datasette::stateSize()
 void
 Datasette::didLoadFromBuffer(uint8_t **buffer)
 {
-    if (data) delete[] data;
-    
-    if (size) {
-        data = new uint8_t[size];
-        readBlock(buffer, data, size);
+    // Keep the tape (and its decoded pulses) if it hasn't changed
+    if (size && size == storageSize && data && pulses &&
+        durationInCycles == pulses[numPulses] &&
+        memcmp(*buffer, data, size) == 0) {
+        
+        *buffer += size;
+        
+    } else {
+        
+        storage.reset();
+        data = NULL;
+        storageSize = 0;
+        
+        if (size) {
+            storage.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+            data = storage.get();
+            storageSize = size;
+            readBlock(buffer, data, size);
+        }
+        decodePulses();
     }
+    
+    scheduleNextEvent();
 }
 
 void
@@ -97,14 +114,90 @@ Datasette::didSaveToBuffer(uint8_t **buffer)
     }
 }
 
+void
+Datasette::shareTape(Datasette *other)
+{
+    assert(other != NULL);
+    
+    storage = other->storage;
+    data = storage.get();
+    storageSize = other->storageSize;
+    size = other->size;
+    type = other->type;
+    pulseStorage = other->pulseStorage;
+    pulses = pulseStorage.get();
+    numPulses = other->numPulses;
+    durationInCycles = other->durationInCycles;
+}
+
+void
+Datasette::decodePulses()
+{
+    pulseStorage.reset();
+    pulses = NULL;
+    numPulses = 0;
+    durationInCycles = 0;
+    
+    if (!size)
+        return;
+    
+    // Each pulse occupies at least one byte
+    pulseStorage.reset(new uint32_t[size + 1], std::default_delete<uint32_t[]>());
+    pulses = pulseStorage.get();
+    
+    uint64_t cycles = 0;
+    for (uint64_t i = 0; i < size; numPulses++) {
+        
+        pulses[numPulses] = (uint32_t)cycles;
+        
+        if (data[i] != 0) {
+            
+            // Pulse lengths between 1 * 8 and 255 * 8
+            cycles += 8 * data[i];
+            i += 1;
+            
+        } else if (type == 0) {
+            
+            // Pulse lengths greater than 8 * 255 (TAP V0 files)
+            cycles += 8 * 256;
+            i += 1;
+            
+        } else {
+            
+            // Pulse lengths greater than 8 * 255 (TAP V1 files)
+            cycles += LO_LO_HI_HI(i + 1 < size ? data[i + 1] : 0,
+                                  i + 2 < size ? data[i + 2] : 0,
+                                  i + 3 < size ? data[i + 3] : 0, 0);
+            i += 4;
+        }
+        
+        // Stop if the pulse offsets run out of range
+        if (cycles > UINT32_MAX) {
+            warn("Tape is too long. Ignoring %lld bytes\n", size - i);
+            cycles = pulses[numPulses];
+            break;
+        }
+    }
+    pulses[numPulses] = (uint32_t)cycles;
+    durationInCycles = cycles;
+    
+    debug(2, "Decoded %lld pulses (%lld cycles)\n", numPulses, durationInCycles);
+}
+
 void
 Datasette::setHeadInCycles(uint64_t value)
 {
-    printf("Fast forwarding to cycle %lld (duration %lld)\n", value, durationInCycles);
-    rewind();
-    while (headInCycles <= value && head < size)
-        advanceHead(true);
-    printf("Head is %llu (max %llu)\n", head, size);
+    debug(2, "Fast forwarding to cycle %lld (duration %lld)\n", value, durationInCycles);
+    
+    if (!hasTape())
+        return;
+    
+    // Find the first pulse starting after the specified position
+    head = std::upper_bound(pulses, pulses + numPulses, value) - pulses;
+    headInCycles = pulses[head];
+    headInSeconds = (uint32_t)(headInCycles / c64->frequency);
+    
+    debug(2, "Head is %llu (max %llu)\n", head, numPulses);
 }
 
 bool
@@ -118,16 +211,15 @@ Datasette::insertTape(TAPFile *a)
     debug(2, "Inserting tape (size = %d, type = %d)...\n", size, type);
     
     // Copy data
-    data = (uint8_t *)malloc(size);
+    storage.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+    data = storage.get();
+    storageSize = size;
     memcpy(data, a->getData(), size);
 
-    // Determine tape length (by fast forwarding)
-    rewind();
-    while (head < size)
-        advanceHead(true /* Don't send tape progress messages */);
-
-    durationInCycles = headInCycles;
+    // Determine pulse positions and tape length
+    decodePulses();
     rewind();
+    scheduleNextEvent();
     
     c64->putMessage(MSG_VC1530_TAPE);
     resume();
@@ -148,12 +240,14 @@ Datasette::ejectTape()
     pressStop();
     
     assert(data != NULL);
-    free(data);
+    storage.reset();
     data = NULL;
+    storageSize = 0;
     size = 0;
     type = 0;
-    durationInCycles = 0;
+    decodePulses();
     head = -1;
+    scheduleNextEvent();
 
     c64->putMessage(MSG_VC1530_NO_TAPE);
     resume();
@@ -163,14 +257,12 @@ void
 Datasette::advanceHead(bool silent)
 {
     // Return if end of tape has been reached already
-    if (head == size)
+    if (head >= numPulses)
         return;
     
     // Update head and headInCycles
-    int length, skip;
-    length = pulseLength(&skip);
-    head += skip;
-    headInCycles += length;
+    head++;
+    headInCycles = pulses[head];
     
     // Send message if the tapeCounter (in seconds) changes
     uint32_t newHeadInSeconds = (uint32_t)(headInCycles / c64->frequency);
@@ -181,49 +273,43 @@ Datasette::advanceHead(bool silent)
     headInSeconds = newHeadInSeconds;
 }
 
-int
-Datasette::pulseLength(int *skip)
-{
-    assert(head < size);
-
-    if (data[head] != 0) {
-        // Pulse lengths between 1 * 8 and 255 * 8
-        if (skip) *skip = 1;
-        return 8 * data[head];
-    }
-    
-    if (type == 0) {
-        // Pulse lengths greater than 8 * 255 (TAP V0 files)
-        if (skip) *skip = 1;
-        return 8 * 256;
-    } else {
-        // Pulse lengths greater than 8 * 255 (TAP V1 files)
-        if (skip) *skip = 4;
-        return  LO_LO_HI_HI(data[head+1], data[head+2], data[head+3], 0);
-    }
-}
-
 void
 Datasette::pressPlay()
 {
     if (!hasTape())
         return;
     
+    suspend();
+    
     debug("Datasette::pressPlay\n");
     playKey = true;
 
     // Schedule first pulse
-    uint64_t length = pulseLength();
-    nextRisingEdge = length / 2;
-    nextFallingEdge = length;
+    if (head < numPulses) {
+        uint64_t length = pulseLength();
+        nextRisingEdge = length / 2;
+        nextFallingEdge = length;
+    }
+    
+    // The tape starts moving in the next cycle (if the motor is on)
+    syncCycle = c64->cpu.cycle;
+    scheduleNextEvent();
+    
+    resume();
 }
 
 void
 Datasette::pressStop()
 {
+    suspend();
+    
     debug("Datasette::pressStop\n");
-    setMotor(false);
+    if (isRunning()) catchUp(c64->cpu.cycle);
+    motor = false;
     playKey = false;
+    scheduleNextEvent();
+    
+    resume();
 }
 
 void
@@ -232,31 +318,78 @@ Datasette::setMotor(bool value)
     if (motor == value)
         return;
     
+    // The motor is switched by the CPU, i.e., before the datasette is
+    // executed in the current cycle.
+    uint64_t cycle = c64->cpu.cycle;
+    
+    if (isRunning()) catchUp(cycle - 1);
     motor = value;
+    if (isRunning()) syncCycle = cycle - 1;
+    
+    scheduleNextEvent();
 }
 
 void
-Datasette::_execute()
+Datasette::catchUp(uint64_t cycle)
 {
-    if (!hasTape() || !playKey || !motor)
-        return;
+    if (cycle > syncCycle) {
+        nextRisingEdge -= cycle - syncCycle;
+        nextFallingEdge -= cycle - syncCycle;
+        syncCycle = cycle;
+    }
+}
+
+void
+Datasette::scheduleNextEvent()
+{
+    wakeUpCycle = UINT64_MAX;
     
-    nextRisingEdge--;
-    nextFallingEdge--;
+    if (!isRunning())
+        return;
     
-    if (nextRisingEdge == 0) {
-        _executeRising();
+    // At the end of the tape, the stop key is pressed in the next cycle
+    if (head >= numPulses) {
+        wakeUpCycle = syncCycle + 1;
         return;
     }
+    
+    // Overdue edges are triggered in the next cycle
+    int64_t next = MIN(nextRisingEdge, nextFallingEdge);
+    wakeUpCycle = syncCycle + MAX(next, 1);
+}
 
-    if (nextFallingEdge == 0 && head < size) {
-        _executeFalling();
+void
+Datasette::execute()
+{
+    catchUp(c64->cpu.cycle);
+    
+    if (head >= numPulses) {
+        pressStop();
         return;
     }
     
-    if (head >= size) {
-        pressStop();
+    // Trigger all edges that are due. If we are called late, the counters
+    // have run below zero and the edges are triggered in a row.
+    while (head < numPulses) {
+        
+        if (nextRisingEdge < nextFallingEdge) {
+            
+            if (nextRisingEdge > 0)
+                break;
+            _executeRising();
+            
+            // Mark the rising edge as done
+            nextRisingEdge = nextFallingEdge;
+            
+        } else {
+            
+            if (nextFallingEdge > 0)
+                break;
+            _executeFalling();
+        }
     }
+    
+    scheduleNextEvent();
 }
 
 void
@@ -270,9 +403,223 @@ Datasette::_executeFalling()
 {
     c64->cia1.triggerFallingEdgeOnFlagPin();
     
-    // Schedule next pulse
+    // Schedule next pulse (relative to the edge, which may be overdue)
     advanceHead();
-    uint64_t length = pulseLength();
-    nextRisingEdge = length / 2;
-    nextFallingEdge = length;
+    if (head < numPulses) {
+        int64_t length = (int64_t)pulseLength();
+        nextRisingEdge = nextFallingEdge + length / 2;
+        nextFallingEdge += length;
+    }
+}
+
+Datasette::PulseType
+Datasette::pulseType(uint64_t nr)
+{
+    if (nr >= numPulses)
+        return INVALID_PULSE;
+    
+    // The nominal lengths are $30 (short), $42 (medium), and $56 (long) in
+    // TAP units of 8 cycles. We classify by the midpoints in between.
+    uint64_t length = (pulses[nr + 1] - pulses[nr]) / 8;
+    
+    if (length < 0x24) return INVALID_PULSE;
+    if (length < 0x39) return SHORT_PULSE;
+    if (length < 0x4C) return MEDIUM_PULSE;
+    if (length < 0x70) return LONG_PULSE;
+    return INVALID_PULSE;
+}
+
+int
+Datasette::decodeByte(uint64_t nr)
+{
+    // Byte marker
+    if (pulseType(nr) != LONG_PULSE || pulseType(nr + 1) != MEDIUM_PULSE)
+        return -1;
+    
+    // Eight data bits and the parity bit
+    int value = 0;
+    uint8_t parity = 1;
+    for (unsigned i = 0; i < 9; i++) {
+        
+        PulseType first = pulseType(nr + 2 + 2 * i);
+        PulseType second = pulseType(nr + 3 + 2 * i);
+        uint8_t bit;
+        
+        if (first == SHORT_PULSE && second == MEDIUM_PULSE) {
+            bit = 0;
+        } else if (first == MEDIUM_PULSE && second == SHORT_PULSE) {
+            bit = 1;
+        } else {
+            return -1;
+        }
+        
+        if (i < 8) value |= bit << i;
+        parity ^= bit;
+    }
+    
+    return parity == 0 ? value : -1;
+}
+
+long
+Datasette::decodeBlockCopy(uint64_t &nr, uint64_t limit,
+                           uint8_t *buffer, size_t capacity, bool &repeated)
+{
+    limit = MIN(limit, numPulses);
+    
+    for (uint64_t i = nr; i < limit; i++) {
+        
+        // Search for a countdown sequence (each byte occupies 20 pulses)
+        int sync = decodeByte(i);
+        if (sync != 0x89 && sync != 0x09)
+            continue;
+        
+        uint64_t pos = i + 20;
+        bool valid = true;
+        for (int j = sync - 1; valid && (j & 0x7F) != 0; j--, pos += 20) {
+            valid = decodeByte(pos) == j;
+        }
+        if (!valid)
+            continue;
+        
+        // Read the data bytes (the last one is the checksum)
+        size_t count = 0;
+        uint8_t checksum = 0;
+        for (int value; (value = decodeByte(pos)) >= 0; pos += 20, count++) {
+            if (buffer && count < capacity) buffer[count] = (uint8_t)value;
+            checksum ^= value;
+        }
+        
+        // The block must be terminated by an end of data marker
+        if (count == 0 || checksum != 0 ||
+            pulseType(pos) != LONG_PULSE || pulseType(pos + 1) != SHORT_PULSE)
+            continue;
+        
+        nr = pos + 2;
+        repeated = (sync == 0x09);
+        return (long)count - 1;
+    }
+    
+    return -1;
+}
+
+long
+Datasette::decodeBlock(uint64_t &nr, uint8_t *buffer, size_t capacity)
+{
+    bool repeated;
+    long length = decodeBlockCopy(nr, numPulses, buffer, capacity, repeated);
+    
+    // Skip the repeated copy which follows after a short gap
+    if (length >= 0 && !repeated) {
+        
+        uint64_t pos = nr;
+        if (decodeBlockCopy(pos, nr + 1000, NULL, 0, repeated) == length && repeated) {
+            nr = pos;
+        }
+    }
+    
+    return length;
+}
+
+bool
+Datasette::fastLoad()
+{
+    C64Memory &mem = c64->mem;
+    CPU &cpu = c64->cpu;
+    
+    // Make sure that we are in the tape branch of an unmodified LOAD routine
+    // (JSR $F7D0) and that a program is to be loaded (not verified)
+    uint16_t addr = C64::KERNAL_TAPE_LOAD;
+    if (mem.rom[addr] != 0x20 || mem.rom[addr + 1] != 0xD0 || mem.rom[addr + 2] != 0xF7)
+        return false;
+    if (!hasTape() || head >= numPulses || mem.ram[0x93] != 0)
+        return false;
+    
+    uint8_t nameLength = MIN(mem.ram[0xB7], 16);
+    uint16_t name = LO_HI(mem.ram[0xBB], mem.ram[0xBC]);
+    
+    // Search for a matching program header
+    uint8_t header[192];
+    uint64_t pos = head;
+    while (1) {
+        
+        long length = decodeBlock(pos, header, sizeof(header));
+        if (length < 0)
+            return false;
+        if (length != sizeof(header))
+            continue;
+        
+        // Let the Kernal deal with the end of tape marker
+        if (header[0] == 5)
+            return false;
+        
+        // Only consider relocatable (1) and non-relocatable (3) programs
+        if (header[0] != 1 && header[0] != 3)
+            continue;
+        
+        bool match = true;
+        for (unsigned i = 0; i < nameLength; i++) {
+            match &= mem.spypeek(name + i) == header[5 + i];
+        }
+        if (match)
+            break;
+    }
+    
+    // Decode the data block
+    uint16_t start = LO_HI(header[1], header[2]);
+    uint16_t count = LO_HI(header[3], header[4]) - start;
+    uint8_t *program = new uint8_t[0x10000];
+    
+    if (decodeBlock(pos, program, 0x10000) < count) {
+        debug(2, "Failed to decode the data block. Loading the slow way.\n");
+        delete[] program;
+        return false;
+    }
+    
+    // Relocatable programs go to the address passed to LOAD if the
+    // secondary address is 0
+    if (header[0] == 1 && mem.ram[0xB9] == 0) {
+        start = LO_HI(mem.ram[0xC3], mem.ram[0xC4]);
+    }
+    uint16_t end = start + count;
+    
+    debug(2, "Loading %d bytes to $%04X\n", count, start);
+    
+    // Copy the header into the tape buffer and the program into memory
+    uint16_t tapeBuffer = LO_HI(mem.ram[0xB2], mem.ram[0xB3]);
+    for (unsigned i = 0; i < sizeof(header); i++) {
+        mem.poke(tapeBuffer + i, header[i]);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        mem.poke(start + i, program[i]);
+    }
+    delete[] program;
+    
+    // Leave the zero page as the Kernal does
+    mem.pokeRam(0xC1, LO_BYTE(start));
+    mem.pokeRam(0xC2, HI_BYTE(start));
+    mem.pokeRam(0xC3, LO_BYTE(start));
+    mem.pokeRam(0xC4, HI_BYTE(start));
+    mem.pokeRam(0xAE, LO_BYTE(end));
+    mem.pokeRam(0xAF, HI_BYTE(end));
+    mem.pokeRam(0x90, 0x00);
+    
+    // Return to the caller of LOAD (carry clear, end address in X and Y)
+    cpu.regX = LO_BYTE(end);
+    cpu.regY = HI_BYTE(end);
+    cpu.setN(cpu.regY & 0x80);
+    cpu.setZ(cpu.regY == 0);
+    cpu.setC(0);
+    uint8_t lo = mem.ram[0x100 + (uint8_t)(++cpu.regSP)];
+    uint8_t hi = mem.ram[0x100 + (uint8_t)(++cpu.regSP)];
+    cpu.regPC = LO_HI(lo, hi) + 1;
+    
+    // Move the head behind the data block and press play, so that a custom
+    // loader contained in the program can read on
+    head = pos;
+    headInCycles = pulses[head];
+    headInSeconds = (uint32_t)(headInCycles / c64->frequency);
+    pressPlay();
+    c64->putMessage(MSG_VC1530_PROGRESS);
+    
+    return true;
 }
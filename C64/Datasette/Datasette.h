@@ -21,6 +21,8 @@
 #ifndef _DATASETTE_INC
 #define _DATASETTE_INC
 
+#include <memory>
+
 class TAPFile;
 
 //! @brief    A Commodore 1530 (C2N) tape recorder (Datasette)
@@ -30,9 +32,23 @@ class Datasette : public VirtualComponent {
     // Tape
     //
     
-    //! @brief    Data buffer (contains the raw data of the TAP archive)
+    /*! @brief    Data buffer (contains the raw data of the TAP archive)
+     *  @details  The buffer is reference counted, because cloned emulator
+     *            instances share the tape data with their origin.
+     *  @see      shareTape()
+     */
+    std::shared_ptr<uint8_t> storage;
+    
+    //! @brief    Shortcut to storage.get()
     uint8_t *data = NULL;
     
+    /*! @brief    Size of the buffer referenced by storage
+     *  @details  Unlike size, this value is not part of the snapshot. It
+     *            tells if a shared buffer can be compared with the tape data
+     *            of a snapshot that is being restored.
+     */
+    uint64_t storageSize = 0;
+    
     //! @brief    Size of the attached data buffer
     uint64_t size = 0;
     
@@ -50,14 +66,32 @@ class Datasette : public VirtualComponent {
      */
     uint64_t durationInCycles = 0;
     
+    /*! @brief    Pre-decoded pulse stream
+     *  @details  Entry i stores the tape position (in cycles) at which pulse
+     *            i starts. The array has numPulses + 1 entries. The last entry
+     *            equals durationInCycles. The array is computed once when the
+     *            tape is inserted and shared with cloned emulator instances.
+     *  @note     32 bit offsets cover more than 70 minutes of tape. Longer
+     *            tapes are cut off by decodePulses().
+     *  @see      decodePulses()
+     */
+    std::shared_ptr<uint32_t> pulseStorage;
+    
+    //! @brief    Shortcut to pulseStorage.get()
+    uint32_t *pulses = NULL;
+    
+    //! @brief    Number of pulses on the tape
+    uint64_t numPulses = 0;
+    
     
     //
     // Datasette
     //
     
     /*! @brief    Read/Write head
-     *  @details  Value must be between 0 and size.
-     *  @note     head == size indicates EOT (End Of Tape)
+     *  @details  Number of the next pulse. Value must be between 0 and
+     *            numPulses.
+     *  @note     head == numPulses indicates EOT (End Of Tape)
      */
     uint64_t head = 0;
     
@@ -72,13 +106,24 @@ class Datasette : public VirtualComponent {
     uint32_t headInSeconds = 0;
     
     /*! @brief    Next scheduled rising edge on data line
+     *  @details  Number of cycles the tape has to move until the edge occurs,
+     *            counted from syncCycle. Once the edge has been triggered,
+     *            the value equals nextFallingEdge.
      */
     int64_t nextRisingEdge = 0;
     
     /*! @brief    Next scheduled falling edge on data line
+     *  @details  Number of cycles the tape has to move until the edge occurs,
+     *            counted from syncCycle.
      */
     int64_t nextFallingEdge = 0;
     
+    /*! @brief    Cycle up to which the edge counters have been updated
+     *  @details  The counters are only updated when the datasette is executed
+     *            or its motor state changes.
+     */
+    uint64_t syncCycle = 0;
+    
     /*! @brief    Indicates whether the play key is pressed
      */
     bool playKey = false;
@@ -90,6 +135,12 @@ class Datasette : public VirtualComponent {
     
 public:
     
+    /*! @brief    Cycle in which the datasette needs to be executed next
+     *  @details  The value is UINT64_MAX if the tape doesn't move.
+     */
+    uint64_t wakeUpCycle = UINT64_MAX;
+    
+    
     //
     //! @functiongroup Creating and destructing
     //
@@ -126,6 +177,15 @@ public:
      */
     void ejectTape();
 
+    /*! @brief    Makes this datasette reference the tape of another datasette.
+     *  @details  The old buffer is released. This is used by C64::clone()
+     *            before the state is transferred. When the state is loaded,
+     *            didLoadFromBuffer() finds the same tape already in place and
+     *            keeps it. Hence, the clone never allocates a copy of the
+     *            (immutable) tape data.
+     */
+    void shareTape(Datasette *other);
+
     //! @brief    Returns the tape type (TAP format, 0 or 1).
     uint8_t getType() { return type; }
 
@@ -142,6 +202,12 @@ public:
 
     //! @brief    Puts the read/write head at the beginning of the tape.
     void rewind() { head = headInSeconds = headInCycles = 0; }
+    
+    /*! @brief    Decodes the pulse stream of the attached data buffer
+     *  @details  This function computes the pulses array and durationInCycles.
+     *            Pulses beyond the range of the 32 bit offsets are dropped.
+     */
+    void decodePulses();
 
     /*! @brief    Advances the read/write head one pulse.
      *  @details  This methods updates head, headInCycles, and headInSeconds.
@@ -158,12 +224,15 @@ public:
     //! @brief    Returns the head position in seconds
     uint32_t getHeadInSeconds() { return headInSeconds; }
     
-    //! @brief    Sets the current head position in cycles.
+    /*! @brief    Sets the current head position in cycles.
+     *  @details  The head is moved to the first pulse starting after the
+     *            specified position. The pulse is located by binary search.
+     */
     void setHeadInCycles(uint64_t value);
     
     //! @brief    Returns the pulse length at the current head position
-    int pulseLength(int *skip);
-    int pulseLength() { return pulseLength(NULL); }
+    uint64_t pulseLength() {
+        assert(head < numPulses); return pulses[head + 1] - pulses[head]; }
 
     
     //
@@ -190,20 +259,94 @@ public:
      */
     void setMotor(bool value);
 
-    /*! @brief  Executes the virtual datasette
+    /*! @brief    Executes the virtual datasette
+     *  @details  This function is called in wakeUpCycle.
      */
-    void execute() { if (playKey && motor) _execute(); }
+    void execute();
+    
+    
+    //
+    //! @functiongroup Loading standard tapes instantly
+    //
+    
+    /*! @brief    Replaces the Kernal's tape load routine
+     *  @details  This function is invoked when the CPU enters the tape branch
+     *            of the Kernal's LOAD routine. It searches the tape for a
+     *            header block in standard CBM format that matches the file
+     *            name, decodes the header and data blocks directly from the
+     *            pulse stream, and writes them into memory. Registers, zero
+     *            page, and the tape buffer are set up like the Kernal does
+     *            after a successful load. The read/write head is placed
+     *            behind the data block, so that a loader can continue from
+     *            there.
+     *  @return   true, if the program has been loaded. false, if the tape
+     *            doesn't contain a decodable program in standard format. In
+     *            that case, nothing has been changed and the Kernal routine
+     *            is executed as usual.
+     */
+    bool fastLoad();
 
 private:
 
-    //! @brief    Internal execution function
-    void _execute();
+    //! @brief    Returns true if the tape is moving
+    bool isRunning() { return hasTape() && playKey && motor; }
+    
+    //! @brief    Updates the edge counters up to the specified cycle
+    void catchUp(uint64_t cycle);
+    
+    //! @brief    Computes wakeUpCycle
+    void scheduleNextEvent();
 
     //! @brief    Simulates the falling edge of a pulse
     void _executeFalling();
 
     //! @brief    Simulates the rising edge of a pulse
     void _executeRising();
+    
+    //! @brief    Pulse types of the standard CBM tape format
+    typedef enum {
+        INVALID_PULSE,
+        SHORT_PULSE,
+        MEDIUM_PULSE,
+        LONG_PULSE
+    } PulseType;
+    
+    //! @brief    Classifies a pulse according to the standard CBM format
+    PulseType pulseType(uint64_t nr);
+    
+    /*! @brief    Decodes a single byte in standard CBM format
+     *  @details  A byte starts with a byte marker (long, medium) followed by
+     *            eight data bits (LSB first) and an odd parity bit. Each bit
+     *            is encoded by a pulse pair (short, medium = 0, medium, short
+     *            = 1).
+     *  @param    nr Number of the first pulse of the byte marker
+     *  @return   The decoded byte or -1 if the pulses don't form a valid byte
+     */
+    int decodeByte(uint64_t nr);
+    
+    /*! @brief    Decodes a single copy of a data block
+     *  @details  The function searches for a countdown sequence ($89 ... $81
+     *            or $09 ... $01), reads the data bytes up to the end of data
+     *            marker, and verifies the checksum.
+     *  @param    nr Number of the pulse to start the search at. On success,
+     *            the number of the first pulse behind the block.
+     *  @param    limit Number of the pulse to stop the search at
+     *  @param    buffer Destination buffer (may be NULL)
+     *  @param    capacity Size of the destination buffer. Surplus bytes are
+     *            skipped.
+     *  @param    repeated Set to true if the repeated copy has been found
+     *  @return   Number of data bytes in the block or -1 if no valid block
+     *            has been found
+     */
+    long decodeBlockCopy(uint64_t &nr, uint64_t limit,
+                         uint8_t *buffer, size_t capacity, bool &repeated);
+    
+    /*! @brief    Decodes a data block in standard CBM format
+     *  @details  Each block is stored twice on tape. The repeated copy is
+     *            only needed if the first copy is damaged.
+     *  @see      decodeBlockCopy()
+     */
+    long decodeBlock(uint64_t &nr, uint8_t *buffer, size_t capacity);
 
 };
 
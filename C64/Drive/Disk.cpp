@@ -77,6 +77,39 @@ const Disk::TrackDefaults Disk::trackDefaults[43] = {
     { 17, 0, 6250, 6250 * 8, 785, 0.830 }  // Track 42
 };
 
+// 64COPY (fails on VICE test drive/skew)
+/*
+const int Disk::tailGap[4] = { 9, 9, 9, 9 };
+const uint16_t Disk::trackLength[4] =
+{
+    6250 * 8, // Tracks 31 - 35..42 (inner tracks)
+    6666 * 8, // Tracks 25 - 30
+    7142 * 8, // Tracks 18 - 24
+    7692 * 8  // Tracks  1 - 17     (outer tracks)
+};
+*/
+
+// Hoxs64 (passes VICE test drive/skew)
+const int Disk::tailGap[4] = { 9, 12, 17, 8 };
+const uint16_t Disk::trackLength[4] =
+{
+    6250 * 8, // Tracks 31 - 35..42 (inner tracks)
+    6667 * 8, // Tracks 25 - 30
+    7143 * 8, // Tracks 18 - 24
+    7693 * 8  // Tracks  1 - 17     (outer tracks)
+};
+
+// VirtualC64 2.4
+/*
+const int Disk::tailGap[4] = { 13, 16, 21, 12 };
+const uint16_t Disk::trackLength[4] =
+{
+    (uint16_t)(8 * 17 * (354 + tailGap[0])), // Tracks 31 - 35..42 (inner tracks)
+    (uint16_t)(8 * 18 * (354 + tailGap[1])), // Tracks 25 - 30
+    (uint16_t)(8 * 19 * (354 + tailGap[2])), // Tracks 18 - 24
+    (uint16_t)(8 * 21 * (354 + tailGap[3]))  // Tracks  1 - 17     (outer tracks)
+};
+*/
 
 Disk::Disk()
 {
@@ -92,26 +125,17 @@ Disk::Disk()
     
     registerSnapshotItems(items, sizeof(items));
 
-    // Create bit expansion table
-    // Note that this table expects a LITTLE ENDIAN architecture to work. If you compile
-    // the emulator on a BIG ENDIAN architecture, the byte order needs to be reversed.
-    for (unsigned i = 0; i < 256; i++) {
-        bitExpansion[i] = 0;
-        if (i & 0x80) bitExpansion[i] |= 0x0000000000000001;
-        if (i & 0x40) bitExpansion[i] |= 0x0000000000000100;
-        if (i & 0x20) bitExpansion[i] |= 0x0000000000010000;
-        if (i & 0x10) bitExpansion[i] |= 0x0000000001000000;
-        if (i & 0x08) bitExpansion[i] |= 0x0000000100000000;
-        if (i & 0x04) bitExpansion[i] |= 0x0000010000000000;
-        if (i & 0x02) bitExpansion[i] |= 0x0001000000000000;
-        if (i & 0x01) bitExpansion[i] |= 0x0100000000000000;
-    }
+    pthread_mutex_init(&encodeLock, NULL);
+    for (Halftrack ht = 0; ht < 85; ht++) pending[ht] = false;
     
     clearDisk();
 }
 
 Disk::~Disk()
 {
+    discardPendingHalftracks();
+    pthread_mutex_destroy(&encodeLock);
+    delete[] previousData;
 }
 
 void
@@ -145,30 +169,52 @@ Disk::setModified(bool b)
 
 
 void
-Disk::encodeGcr(uint8_t value, Track t, HeadPosition offset)
+Disk::writeBitsToHalftrack(Halftrack ht, HeadPosition pos, uint64_t bits, unsigned count)
 {
-    assert(isTrackNumber(t));
+    assert(isHalftrackNumber(ht));
+    assert(count <= 56);
+    
+    if (count == 0)
+        return;
+    
+    pos = fitToBounds(ht, pos);
     
-    uint8_t nibble1 = bin2gcr(value >> 4);
-    uint8_t nibble2 = bin2gcr(value & 0xF);
+    // Write bit by bit if the sequence wraps around
+    if (pos < 0 || pos + count > length.halftrack[ht]) {
+        for (unsigned i = count; i > 0; i--)
+            _writeBitToHalftrack(ht, fitToBounds(ht, pos++), (bits >> (i - 1)) & 1);
+        return;
+    }
     
-    writeBitToTrack(t, offset++, nibble1 & 0x10);
-    writeBitToTrack(t, offset++, nibble1 & 0x08);
-    writeBitToTrack(t, offset++, nibble1 & 0x04);
-    writeBitToTrack(t, offset++, nibble1 & 0x02);
-    writeBitToTrack(t, offset++, nibble1 & 0x01);
+    // Align the sequence with the first affected byte and merge it in
+    dirty[ht] = true;
+    unsigned shift = 64 - count - (pos % 8);
+    uint64_t mask = ((((uint64_t)1) << count) - 1) << shift;
+    bits = (bits << shift) & mask;
+    
+    uint8_t *p = data.halftrack[ht] + pos / 8;
+    unsigned bytes = (pos % 8 + count + 7) / 8;
+    for (unsigned i = 0; i < bytes; i++) {
+        unsigned s = 56 - 8 * i;
+        p[i] = (p[i] & ~(uint8_t)(mask >> s)) | (uint8_t)(bits >> s);
+    }
+}
 
-    writeBitToTrack(t, offset++, nibble2 & 0x10);
-    writeBitToTrack(t, offset++, nibble2 & 0x08);
-    writeBitToTrack(t, offset++, nibble2 & 0x04);
-    writeBitToTrack(t, offset++, nibble2 & 0x02);
-    writeBitToTrack(t, offset++, nibble2 & 0x01);
+void
+Disk::encodeGcr(uint8_t value, Track t, HeadPosition offset)
+{
+    assert(isTrackNumber(t));
+    
+    writeBitsToTrack(t, offset, bin2gcr10(value), 10);
 }
 
 void
 Disk::encodeGcr(uint8_t *values, size_t length, Track t, HeadPosition offset)
 {
-    for (size_t i = 0; i < length; i++, values++, offset += 10) {
+    for (; length >= 4; length -= 4, values += 4, offset += 40) {
+        encodeGcr(values[0], values[1], values[2], values[3], t, offset);
+    }
+    for (; length > 0; length--, values++, offset += 10) {
         encodeGcr(*values, t, offset);
     }
 }
@@ -178,49 +224,55 @@ Disk::encodeGcr(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, Track t, unsigne
 {
     assert(isTrackNumber(t));
     
-    uint8_t buffer[] = { b1, b2, b3, b4 };
+    uint64_t shift_reg =
+    ((uint64_t)bin2gcr10(b1) << 30) | ((uint64_t)bin2gcr10(b2) << 20) |
+    ((uint64_t)bin2gcr10(b3) << 10) | (uint64_t)bin2gcr10(b4);
     
-    encodeGcr(buffer, 4, t, offset);
-    /*
-    uint64_t shift_reg = 0;
+    writeBitsToTrack(t, offset, shift_reg, 40);
+}
+
+uint64_t
+Disk::trackInfoBits(size_t offset)
+{
+    assert(offset < 2 * maxBitsOnTrack);
+    
+    const uint8_t *p = trackInfo.bits + (offset >> 3);
+    unsigned shift = offset & 7;
     
-    // Shift in
-    shift_reg = gcr[b1 >> 4];
-    shift_reg = (shift_reg << 5) | gcr[b1 & 0x0F];
-    shift_reg = (shift_reg << 5) | gcr[b2 >> 4];
-    shift_reg = (shift_reg << 5) | gcr[b2 & 0x0F];
-    shift_reg = (shift_reg << 5) | gcr[b3 >> 4];
-    shift_reg = (shift_reg << 5) | gcr[b3 & 0x0F];
-    shift_reg = (shift_reg << 5) | gcr[b4 >> 4];
-    shift_reg = (shift_reg << 5) | gcr[b4 & 0x0F];
+    uint64_t word =
+    (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 | (uint64_t)p[2] << 40 |
+    (uint64_t)p[3] << 32 | (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 |
+    (uint64_t)p[6] << 8 | (uint64_t)p[7];
     
-    // Shift out
-    writeByteToTrack(t, offset + 4 * 8, shift_reg & 0xFF); shift_reg >>= 8;
-    writeByteToTrack(t, offset + 3 * 8, shift_reg & 0xFF); shift_reg >>= 8;
-    writeByteToTrack(t, offset + 2 * 8, shift_reg & 0xFF); shift_reg >>= 8;
-    writeByteToTrack(t, offset + 1 * 8, shift_reg & 0xFF); shift_reg >>= 8;
-    writeByteToTrack(t, offset, shift_reg & 0xFF);
-    */
+    return shift ? (word << shift) | (p[8] >> (8 - shift)) : word;
 }
 
-uint8_t
-Disk::decodeGcrNibble(uint8_t *gcr)
+void
+Disk::writeTrackInfoBits(size_t offset, uint64_t bits, unsigned count)
 {
-    assert(gcr != NULL);
+    assert(offset + count <= 2 * maxBitsOnTrack);
+    assert(count >= 1 && count <= 32);
+    
+    uint8_t *p = trackInfo.bits + (offset >> 3);
+    unsigned shift = offset & 7;
     
-    uint5_t codeword = (gcr[0] << 4) | (gcr[1] << 3) | (gcr[2] << 2) | (gcr[3] << 1) | gcr[4];
-    assert(is_uint5_t(codeword));
+    // Merge the bits into the 40 bit window starting at p
+    uint64_t mask = (~0ULL << (64 - count)) >> shift;
+    uint64_t word = trackInfoBits(offset & ~7);
+    word = (word & ~mask) | ((bits >> shift) & mask);
     
-    return invgcr[codeword];
+    for (unsigned i = 0; i < 5; i++) {
+        p[i] = (uint8_t)(word >> (56 - 8 * i));
+    }
 }
 
 uint8_t
-Disk::decodeGcr(uint8_t *gcr)
+Disk::decodeGcr(size_t offset)
 {
-    assert(gcr != NULL);
+    uint16_t codeword = (uint16_t)(trackInfoBits(offset) >> 54);
     
-    uint4_t nibble1 = decodeGcrNibble(gcr);
-    uint4_t nibble2 = decodeGcrNibble(gcr + 5);
+    uint4_t nibble1 = invgcr[codeword >> 5];
+    uint4_t nibble2 = invgcr[codeword & 0x1F];
 
     // assert(is_uint4_t(nibble1));
     // assert(is_uint4_t(nibble2));
@@ -248,9 +300,39 @@ Disk::_bitDelay(Halftrack ht, HeadPosition pos) {
      return 4 * 8125;     // Density bits = 11: 4 * 13/16 * 10^4 1/10 nsec
 }
 
+void
+Disk::willLoadFromBuffer(uint8_t **buffer)
+{
+    discardPendingHalftracks();
+    
+    // Remember the current disk. Run-ahead mode restores the state every
+    // frame, most of the time with the same disk data.
+    if (previousData == NULL) {
+        previousData = new uint8_t[85][maxBytesOnTrack];
+    }
+    memcpy(previousData, data.halftrack, sizeof(data.halftrack));
+    memcpy(previousLength, length.halftrack, sizeof(length.halftrack));
+}
+
+void
+Disk::didLoadFromBuffer(uint8_t **buffer)
+{
+    // Only mark the halftracks as dirty that have changed
+    for (Halftrack ht = 1; ht <= maxNumberOfHalftracks; ht++) {
+        if (previousLength[ht] != length.halftrack[ht] ||
+            memcmp(previousData[ht], data.halftrack[ht], maxBytesOnTrack) != 0) {
+            dirty[ht] = true;
+        }
+    }
+}
+
 void
 Disk::clearHalftrack(Halftrack ht)
 {
+    if (pending[ht]) {
+        pending[ht] = false;
+        numPending--;
+    }
     memset(&data.halftrack[ht], 0x55, sizeof(data.halftrack[ht]));
     length.halftrack[ht] = sizeof(data.halftrack[ht]) * 8;
 }
@@ -258,6 +340,8 @@ Disk::clearHalftrack(Halftrack ht)
 void
 Disk::clearDisk()
 {
+    discardPendingHalftracks();
+    
     // memset(&data, 0x55, sizeof(data));
     for (Halftrack ht = 1; ht <= maxNumberOfHalftracks; ht++) {
         // length.halftrack[ht] = sizeof(data.halftrack[ht]) * 8;
@@ -265,12 +349,14 @@ Disk::clearDisk()
     }
     writeProtected = false;
     modified = false; 
+    setDirty(false);
 }
 
 bool
 Disk::halftrackIsEmpty(Halftrack ht)
 {
     assert(isHalftrackNumber(ht));
+    if (pending[ht]) return false;
     for (unsigned i = 0; i < sizeof(data.halftrack[ht]); i++)
         if (data.halftrack[ht][i] != 0x55) return false;
     return true;
@@ -306,6 +392,7 @@ Disk::analyzeHalftrack(Halftrack ht)
 {
     assert(isHalftrackNumber(ht));
     
+    encodeIfPending(ht);
     uint16_t len = length.halftrack[ht];
 
     errorLog.clear();
@@ -316,57 +403,76 @@ Disk::analyzeHalftrack(Halftrack ht)
     memset(&trackInfo, 0, sizeof(trackInfo));
     trackInfo.length = len;
     
-    // Setup working buffer (two copies of the track, each bit represented by one byte).
-    for (unsigned i = 0; i < maxBytesOnTrack; i++)
-        trackInfo.byte[i] = bitExpansion[data.halftrack[ht][i]];
-    memcpy(trackInfo.bit + len, trackInfo.bit, len);
+    // Setup working buffer (two copies of the track)
+    memcpy(trackInfo.bits, data.halftrack[ht], maxBytesOnTrack);
+    for (unsigned i = 0; i < len; i += 32) {
+        unsigned count = MIN(32, len - i);
+        writeTrackInfoBits(len + i, trackInfoBits(i), count);
+    }
     
-    // Indicates where the sector headers blocks and the sectors data blocks start.
-    uint8_t sync[sizeof(trackInfo.bit)];
-    memset(sync, 0, sizeof(sync));
+    // Offsets and IDs of all blocks following a SYNC sequence
+    std::vector<std::pair<unsigned, uint8_t>> sync;
     
     // Scan for SYNC sequences and decode the byte that follows.
-    unsigned noOfOnes = 0;
-    for (unsigned i = 0; i < 2 * len - 10; i++) {
+    // The track is processed in 64 bit windows, each advancing by 54 bits.
+    // Bit k of a window is a block start if it is 0 and preceded by at
+    // least 10 ones inside the window.
+    unsigned end = 2 * len > 10 ? 2 * len - 10 : 0;
+    for (unsigned pos = 0; pos + 10 < end; pos += 54) {
+        
+        uint64_t bits = trackInfoBits(pos);
+        uint64_t ones2 = bits & (bits >> 1);
+        uint64_t ones4 = ones2 & (ones2 >> 2);
+        uint64_t ones8 = ones4 & (ones4 >> 4);
+        uint64_t ones10 = ones8 & (ones2 >> 8);
+        uint64_t starts = (ones10 >> 1) & ~bits;
         
-        assert(trackInfo.bit[i] <= 1);
-        if (trackInfo.bit[i] == 0 && noOfOnes >= 10) {
+        while (starts) {
+            
+            unsigned k = __builtin_clzll(starts);
+            unsigned i = pos + k;
+            if (i >= end)
+                break;
+            starts &= ~(0x8000000000000000ULL >> k);
             
-            // <--- SYNC ---><-- sync[i] -->
+            // <--- SYNC ---><-- id -->
             // 11111 .... 1110
             //               ^ <- We are at offset i which is here
-            sync[i] = decodeGcr(trackInfo.bit + i);
+            uint8_t id = decodeGcr(i);
+            sync.push_back(std::make_pair(i, id));
             
-            if (sync[i] == 0x08) {
+            if (id == 0x08) {
                 debug(2, "Sector header block found at offset %d\n", i);
-            } else if (sync[i] == 0x07) {
+            } else if (id == 0x07) {
                 debug(2, "Sector data block found at offset %d\n", i);
             } else {
-                log(i, 10, "Invalid sector ID %02X at index %d. Should be 0x07 or 0x08.", sync[i], i);
+                log(i, 10, "Invalid sector ID %02X at index %d. Should be 0x07 or 0x08.", id, i);
             }
         }
-        noOfOnes = trackInfo.bit[i] ? (noOfOnes + 1) : 0;
     }
     
     // Lookup first sector header block
-    unsigned startOffset;
-    for (startOffset = 0; startOffset < len; startOffset++) {
-        if (sync[startOffset] == 0x08) {
+    size_t first;
+    for (first = 0; first < sync.size() && sync[first].first < len; first++) {
+        if (sync[first].second == 0x08) {
             break;
         }
     }
-    if (startOffset == len) {
+    if (first == sync.size() || sync[first].first >= len) {
         log(0, len, "Track contains no sector header block.");
         return;
     }
+    unsigned startOffset = sync[first].first;
     
     // Compute offsets for all sectors
     uint8_t sector = UINT8_MAX;
-    for (unsigned i = startOffset; i < startOffset + len; i++) {
+    for (size_t nr = first; nr < sync.size() && sync[nr].first < startOffset + len; nr++) {
         
-        if (sync[i] == 0x08) {
+        unsigned i = sync[nr].first;
+        
+        if (sync[nr].second == 0x08) {
             
-            sector = decodeGcr(trackInfo.bit + i + 20);
+            sector = decodeGcr(i + 20);
             
             if (isSectorNumber(sector)) {
                 if (trackInfo.sectorInfo[sector].headerEnd != 0)
@@ -377,7 +483,7 @@ Disk::analyzeHalftrack(Halftrack ht)
                 log(i + 20, 10, "Header block at index %d contains an invalid sector number (%d).", i, sector);
             }
         
-        } else if (sync[i] == 0x07) {
+        } else if (sync[nr].second == 0x07) {
             
             if (isSectorNumber(sector)) {
                 trackInfo.sectorInfo[sector].dataBegin = i;
@@ -420,16 +526,16 @@ void
 Disk::analyzeSectorHeaderBlock(size_t offset)
 {
     // The first byte must be 0x08 (indicating a header block)
-    assert(decodeGcr(trackInfo.bit + offset) == 0x08);
+    assert(decodeGcr(offset) == 0x08);
     offset += 10;
     
-    uint8_t s = decodeGcr(trackInfo.bit + offset + 10);
-    uint8_t t = decodeGcr(trackInfo.bit + offset + 20);
-    uint8_t id2 = decodeGcr(trackInfo.bit + offset + 30);
-    uint8_t id1 = decodeGcr(trackInfo.bit + offset + 40);
+    uint8_t s = decodeGcr(offset + 10);
+    uint8_t t = decodeGcr(offset + 20);
+    uint8_t id2 = decodeGcr(offset + 30);
+    uint8_t id1 = decodeGcr(offset + 40);
     uint8_t checksum = id1 ^ id2 ^ t ^ s;
 
-    if (checksum != decodeGcr(trackInfo.bit + offset)) {
+    if (checksum != decodeGcr(offset)) {
         log(offset, 10, "Header block at index %d contains an invalid checksum.\n", offset);
     }
 }
@@ -438,15 +544,15 @@ void
 Disk::analyzeSectorDataBlock(size_t offset)
 {
     // The first byte must be 0x07 (indicating a header block)
-    assert(decodeGcr(trackInfo.bit + offset) == 0x07);
+    assert(decodeGcr(offset) == 0x07);
     offset += 10;
     
     uint8_t checksum = 0;
     for (unsigned i = 0; i < 256; i++, offset += 10) {
-        checksum ^= decodeGcr(trackInfo.bit + offset);
+        checksum ^= decodeGcr(offset);
     }
     
-    if (checksum != decodeGcr(trackInfo.bit + offset)) {
+    if (checksum != decodeGcr(offset)) {
         log(offset, 10, "Data block at index %d contains an invalid checksum.\n", offset);
     }
 }
@@ -475,7 +581,7 @@ Disk::diskNameAsString()
     size_t offset = trackInfo.sectorInfo[0].dataBegin + (0x90 * 10);
     
     for (i = 0; i < 255; i++, offset += 10) {
-        uint8_t value = decodeGcr(trackInfo.bit + offset);
+        uint8_t value = decodeGcr(offset);
         if (value == 0xA0)
             break;
         text[i] = value;
@@ -490,7 +596,7 @@ Disk::trackDataAsString()
 {
     size_t i;
     for (i = 0; i < trackInfo.length; i++) {
-        if (trackInfo.bit[i]) {
+        if (trackInfo.bits[i >> 3] & (0x80 >> (i & 7))) {
             text[i] = '1';
         } else {
             text[i] = '0';
@@ -506,7 +612,7 @@ Disk::sectorHeaderAsString(Sector nr)
     assert(isSectorNumber(nr));
     size_t begin = trackInfo.sectorInfo[nr].headerBegin;
     size_t end = trackInfo.sectorInfo[nr].headerEnd;
-    return (begin == end) ? "" : sectorBytesAsString(trackInfo.bit + begin, 10);
+    return (begin == end) ? "" : sectorBytesAsString(begin, 10);
 }
 
 const char *
@@ -515,17 +621,17 @@ Disk::sectorDataAsString(Sector nr)
     assert(isSectorNumber(nr));
     size_t begin = trackInfo.sectorInfo[nr].dataBegin;
     size_t end = trackInfo.sectorInfo[nr].dataEnd;
-    return (begin == end) ? "" : sectorBytesAsString(trackInfo.bit + begin, 256);
+    return (begin == end) ? "" : sectorBytesAsString(begin, 256);
 }
 
 const char *
-Disk::sectorBytesAsString(uint8_t *buffer, size_t length)
+Disk::sectorBytesAsString(size_t offset, size_t length)
 {
-    size_t gcr_offset = 0;
+    size_t gcr_offset = offset;
     size_t str_offset = 0;
     
     for (size_t i = 0; i < length; i++, gcr_offset += 10, str_offset += 3) {
-        uint8_t value = decodeGcr(buffer + gcr_offset);
+        uint8_t value = decodeGcr(gcr_offset);
         sprint8x(text + str_offset, value);
         text[str_offset + 2] = ' ';
     }
@@ -606,12 +712,12 @@ size_t
 Disk::decodeSector(size_t offset, uint8_t *dest)
 {
     // The first byte must be 0x07 (indicating a data block)
-    assert(decodeGcr(trackInfo.bit + offset) == 0x07);
+    assert(decodeGcr(offset) == 0x07);
     offset += 10;
     
     if (dest) {
         for (unsigned i = 0; i < 256; i++) {
-            dest[i] = decodeGcr(trackInfo.bit + offset);
+            dest[i] = decodeGcr(offset);
             offset += 10;
         }
     }
@@ -680,41 +786,6 @@ Disk::encodeArchive(D64File *a, bool alignTracks)
 {
     assert(a != NULL);
     
-    // 64COPY (fails on VICE test drive/skew)
-    /*
-    int tailGap[4] = { 9, 9, 9, 9 };
-    uint16_t trackLength[4] =
-    {
-        6250 * 8, // Tracks 31 - 35..42 (inner tracks)
-        6666 * 8, // Tracks 25 - 30
-        7142 * 8, // Tracks 18 - 24
-        7692 * 8  // Tracks  1 - 17     (outer tracks)
-    };
-    */
-    
-    // Hoxs64 (passes VICE test drive/skew)
-    int tailGap[4] = { 9, 12, 17, 8 };
-    uint16_t trackLength[4] =
-    {
-        6250 * 8, // Tracks 31 - 35..42 (inner tracks)
-        6667 * 8, // Tracks 25 - 30
-        7143 * 8, // Tracks 18 - 24
-        7693 * 8  // Tracks  1 - 17     (outer tracks)
-    };
-    
-    // VirtualC64 2.4
-    /*
-    const int tailGap[4] = { 13, 16, 21, 12 };
-    const uint16_t trackLength[4] =
-    {
-        (uint16_t)(8 * 17 * (354 + tailGap[0])), // Tracks 31 - 35..42 (inner tracks)
-        (uint16_t)(8 * 18 * (354 + tailGap[1])), // Tracks 25 - 30
-        (uint16_t)(8 * 19 * (354 + tailGap[2])), // Tracks 18 - 24
-        (uint16_t)(8 * 21 * (354 + tailGap[3]))  // Tracks  1 - 17     (outer tracks)
-    };
-    */
-    
-    size_t encodedBits;
     unsigned numTracks = a->numberOfTracks();
 
     debug(2, "Encoding D64 archive with %d tracks\n", numTracks);
@@ -726,25 +797,87 @@ Disk::encodeArchive(D64File *a, bool alignTracks)
      for (Halftrack ht = 1; ht <= maxNumberOfHalftracks; ht++)
          length.halftrack[ht] = trackLength[speedZoneOfHalftrack(ht)];
     
-    // Encode tracks
-    HeadPosition start;
+    // Do some consistency checking
+    for (Halftrack ht = 1; ht <= maxNumberOfHalftracks; ht++) {
+        assert(length.halftrack[ht] <= sizeof(data.halftrack[ht]) * 8);
+    }
+    
+    // Keep a private copy of the archive. The tracks are encoded on demand.
+    size_t size = a->sizeOnDisk();
+    uint8_t *buffer = new uint8_t[size];
+    a->writeToBuffer(buffer);
+    pendingArchive = D64File::makeWithBuffer(buffer, size);
+    delete[] buffer;
+    
+    if (pendingArchive == NULL) {
+        warn("Failed to copy D64 archive. Encoding all tracks now.\n");
+        for (Track t = 1; t <= numTracks; t++)
+            encodeTrack(a, t, tailGap[speedZoneOfTrack(t)], trackStart(t, alignTracks));
+        setDirty(false);
+        return;
+    }
+    
+    pendingAlignment = alignTracks;
     for (Track t = 1; t <= numTracks; t++) {
+        pending[2 * t - 1] = true;
+        numPending++;
+    }
+}
+
+HeadPosition
+Disk::trackStart(Track t, bool alignTracks)
+{
+    return alignTracks ? (HeadPosition)(length.track[t][0] * trackDefaults[t].stagger) : 0;
+}
+
+void
+Disk::encodePendingHalftrack(Halftrack ht)
+{
+    assert(isHalftrackNumber(ht));
+    
+    pthread_mutex_lock(&encodeLock);
+    
+    if (pending[ht].load(std::memory_order_relaxed)) {
         
-        unsigned zone = speedZoneOfTrack(t);
-        if (alignTracks) {
-            start = (HeadPosition)(length.track[t][0] * trackDefaults[t].stagger);
-        } else {
-            start = 0;
-        }
-        encodedBits = encodeTrack(a, t, tailGap[zone], start);
+        Track t = (ht + 1) / 2;
+        HeadPosition start = trackStart(t, pendingAlignment);
+        size_t encodedBits = encodeTrack(pendingArchive, t, tailGap[speedZoneOfTrack(t)], start);
         debug(2, "Encoded %d bits (%d bytes) for track %d.\n",
               encodedBits, encodedBits / 8, t);
+        
+        // Encoding a track doesn't count as a modification
+        dirty[ht] = false;
+        pending[ht].store(false, std::memory_order_release);
+        if (--numPending == 0) {
+            delete pendingArchive;
+            pendingArchive = NULL;
+        }
     }
+    
+    pthread_mutex_unlock(&encodeLock);
+}
 
-    // Do some consistency checking
+void
+Disk::encodePendingHalftracks()
+{
+    for (Halftrack ht = 1; ht <= maxNumberOfHalftracks && numPending; ht++) {
+        encodeIfPending(ht);
+    }
+}
+
+void
+Disk::discardPendingHalftracks()
+{
+    pthread_mutex_lock(&encodeLock);
+    
     for (Halftrack ht = 1; ht <= maxNumberOfHalftracks; ht++) {
-        assert(length.halftrack[ht] <= sizeof(data.halftrack[ht]) * 8);
+        pending[ht] = false;
     }
+    numPending = 0;
+    delete pendingArchive;
+    pendingArchive = NULL;
+    
+    pthread_mutex_unlock(&encodeLock);
 }
 
 size_t
@@ -860,12 +993,14 @@ Disk::encodeSector(D64File *a, Track t, Sector s, HeadPosition start, int tailGa
     offset += 10;
     
     // Data bytes
+    uint8_t buffer[256];
     checksum = 0;
-    for (unsigned i = 0; i < 256; i++, offset += 10) {
-        uint8_t byte = (uint8_t)a->readTrack();
-        checksum ^= byte;
-        encodeGcr(byte, t, offset);
+    for (unsigned i = 0; i < 256; i++) {
+        buffer[i] = (uint8_t)a->readTrack();
+        checksum ^= buffer[i];
     }
+    encodeGcr(buffer, 256, t, offset);
+    offset += 256 * 10;
     
     // Checksum
     if (errorCode == 0x5) {
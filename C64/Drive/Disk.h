@@ -24,6 +24,8 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <pthread.h>
+#include <atomic>
 
 #include "VirtualComponent.h"
 #include "Disk_types.h"
@@ -105,13 +107,6 @@ private:
         255,  13,  14, 255  /* 0x1C - 0x1F */
     };
 
-    /*! @brief    Maps a byte to an expanded 64 bit representation
-     *  @details  Example: 0110 ... -> 00000000 00000001 0000001 00000000 ...
-     *            This method is used to quickly inflate a bit stream into a
-     *            byte stream.
-     */
-    uint64_t bitExpansion[256];
-    
     
     //
     // Disk properties
@@ -127,6 +122,19 @@ private:
      */
     bool modified;
     
+    /*! @brief   Indicates which halftracks have been written to
+     *  @details The flags are set whenever a bit is written to a halftrack.
+     *           The disk exporter uses them to write back modified tracks only.
+     */
+    bool dirty[85];
+    
+    /*! @brief   Copy of the halftracks taken before a snapshot is restored
+     *  @details Used to mark only those halftracks as dirty that change.
+     *           The buffer is allocated when the first snapshot is restored.
+     */
+    uint8_t (*previousData)[maxBytesOnTrack] = NULL;
+    uint16_t previousLength[85];
+    
     
     //
     // Disk data
@@ -161,6 +169,43 @@ public:
     } length;
 
     
+    //
+    // Lazy encoding
+    //
+    
+private:
+    
+    /*! @brief    Archive the pending tracks are encoded from
+     *  @details  When a D64 archive is inserted, the tracks are not encoded
+     *            right away. The disk keeps a private copy of the archive and
+     *            encodes a track when its data is accessed for the first time.
+     */
+    D64File *pendingArchive = NULL;
+    
+    //! @brief    Indicates if the pending tracks are aligned
+    bool pendingAlignment = false;
+    
+    /*! @brief    Indicates which halftracks still have to be encoded
+     *  @details  The flags are checked without holding encodeLock (see
+     *            encodeIfPending()). A flag is cleared with release semantics
+     *            after the track has been encoded and read with acquire
+     *            semantics. Hence, a thread that sees a cleared flag also
+     *            sees the encoded data.
+     */
+    std::atomic<bool> pending[85];
+    
+    //! @brief    Number of halftracks that still have to be encoded
+    std::atomic<unsigned> numPending { 0 };
+    
+    /*! @brief    Mutex protecting the encoding process
+     *  @details  Pending tracks may be encoded by the emulator thread and by
+     *            the GUI thread (e.g., when the disk gets analyzed).
+     */
+    pthread_mutex_t encodeLock;
+    
+public:
+    
+    
     //
     // Debug information
     //
@@ -209,6 +254,9 @@ public:
     
     void dump();
     void ping();
+    void willSaveToBuffer(uint8_t **buffer) { encodePendingHalftracks(); }
+    void willLoadFromBuffer(uint8_t **buffer);
+    void didLoadFromBuffer(uint8_t **buffer);
 
     
     
@@ -227,6 +275,15 @@ public:
     //! @brief Sets modified flag
     void setModified(bool b);
 
+    //! @brief Returns true if the specified halftrack has been written to
+    bool isDirty(Halftrack ht) { assert(isHalftrackNumber(ht)); return dirty[ht]; }
+    
+    //! @brief Clears the dirty flag of a single halftrack
+    void clearDirty(Halftrack ht) { assert(isHalftrackNumber(ht)); dirty[ht] = false; }
+    
+    //! @brief Marks all halftracks as dirty or clean
+    void setDirty(bool value) { for (Halftrack ht = 0; ht < 85; ht++) dirty[ht] = value; }
+
     
     //
     //! @functiongroup Handling Gcr encoded data
@@ -243,6 +300,9 @@ public:
     //! @brief   Returns true if the provided 5 bit codeword is a valid GCR codeword
     bool isGcr(uint5_t value) { assert(is_uint5_t(value)); return invgcr[value] != 0xFF; }
 
+    //! @brief   Converts a byte into a 10 bit GCR codeword
+    uint16_t bin2gcr10(uint8_t value) { return (gcr[value >> 4] << 5) | gcr[value & 0xF]; }
+    
     //! @brief   Encodes a single byte as a GCR bitstream.
     /*! @details Writes 10 bits to the specified position on disk.
      */
@@ -250,23 +310,29 @@ public:
 
     //! @brief   Encodes multiple bytes as a GCR bitstream.
     /*! @details Writes length * 10 bits to the specified position on disk.
+     *           The bytes are processed in groups of four which are turned
+     *           into 40 bits (five GCR bytes) and written in one step.
      */
     void encodeGcr(uint8_t *values, size_t length, Track t, HeadPosition offset);
 
-    /*! @brief   Translates four data bytes into five GCR encodes bytes
-     *! @deprecated
-     */
+    //! @brief   Translates four data bytes into five GCR encoded bytes
     void encodeGcr(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, Track t, unsigned offset);
     
-    //! @brief   Decodes a nibble (4 bit) from a previously encoded GCR bitstream.
-    /*! @return  0xFF, if no valid GCR sequence is found.
+    //! @brief   Reads 64 bits from the track data stored in trackInfo
+    /*! @details The bit at the specified offset is returned in the most
+     *           significant bit.
      */
-    uint8_t decodeGcrNibble(uint8_t *gcrBits);
+    uint64_t trackInfoBits(size_t offset);
 
-    //! @brief   Decodes a byte (8 bit) form a previously encoded GCR bitstream.
+    //! @brief   Writes up to 32 bits into the track data stored in trackInfo
+    /*! @param   bits The bits to write, aligned to the most significant bit.
+     */
+    void writeTrackInfoBits(size_t offset, uint64_t bits, unsigned count);
+
+    //! @brief   Decodes a byte (8 bit) from the GCR bitstream stored in trackInfo
     /*! @note    Returns an unpredictable result if invalid GCR sequences are found.
      */
-    uint8_t decodeGcr(uint8_t *gcrBits);
+    uint8_t decodeGcr(size_t offset);
 
     
     //
@@ -309,6 +375,7 @@ public:
      *  @result	 0x00 or 0x01
      */
     uint8_t readBitFromHalftrack(Halftrack ht, HeadPosition pos) {
+        encodeIfPending(ht);
         return _readBitFromHalftrack(ht, fitToBounds(ht, pos));
     }
  
@@ -317,6 +384,7 @@ public:
      */
     void _writeBitToHalftrack(Halftrack ht, HeadPosition pos, bool bit) {
         assert(isValidHeadPositon(ht, pos));
+        dirty[ht] = true;
         if (bit) {
             data.halftrack[ht][pos / 8] |= (0x0080 >> (pos % 8));
         } else {
@@ -330,6 +398,7 @@ public:
     
     //! @brief  Writes a single bit to disk.
     void writeBitToHalftrack(Halftrack ht, HeadPosition pos, bool bit) {
+        encodeIfPending(ht);
         _writeBitToHalftrack(ht, fitToBounds(ht, pos), bit);
     }
     
@@ -337,10 +406,25 @@ public:
         writeBitToHalftrack(2 * t - 1, pos, bit);
     }
     
+    /*! @brief  Writes a sequence of up to 56 bits to disk.
+     *  @details The bits are taken from the lower end of 'bits', the most
+     *           significant one is written first. If the sequence lies
+     *           inside the halftrack, all bits are merged into the affected
+     *           bytes in a single step. Otherwise, they are written one by one
+     *           and wrap around at the end of the halftrack. In both cases,
+     *           the halftrack is marked as dirty.
+     */
+    void writeBitsToHalftrack(Halftrack ht, HeadPosition pos, uint64_t bits, unsigned count);
+    
+    void writeBitsToTrack(Track t, HeadPosition pos, uint64_t bits, unsigned count) {
+        writeBitsToHalftrack(2 * t - 1, pos, bits, count);
+    }
+    
     //! @brief  Writes a single bit to disk multiple times.
     void writeBitToHalftrack(Halftrack ht, HeadPosition pos, bool bit, size_t count) {
-        for (size_t i = 0; i < count; i++)
-            writeBitToHalftrack(ht, pos++, bit);
+        for (; count > 32; count -= 32, pos += 32)
+            writeBitsToHalftrack(ht, pos, bit ? 0xFFFFFFFF : 0, 32);
+        writeBitsToHalftrack(ht, pos, bit ? 0xFFFFFFFF : 0, (unsigned)count);
     }
     
     void writeBitToTrack(Track t, HeadPosition pos, bool bit, size_t count) {
@@ -349,8 +433,7 @@ public:
 
     //! @brief  Writes a single byte to disk.
     void writeByteToHalftrack(Halftrack ht, HeadPosition pos, uint8_t byte) {
-        for (uint8_t mask = 0x80; mask != 0; mask >>= 1)
-            writeBitToHalftrack(ht, pos++, byte & mask);
+        writeBitsToHalftrack(ht, pos, byte, 8);
     }
 
     void writeByteToTrack(Track t, HeadPosition pos, uint8_t byte) {
@@ -359,8 +442,9 @@ public:
     
     //! @brief   Writes a certain number of interblock bytes to disk.
     void writeGapToHalftrack(Halftrack ht, HeadPosition pos, size_t length) {
-        for (size_t i = 0; i < length; i++, pos += 8)
-            writeByteToHalftrack(ht, pos, 0x55);
+        for (; length > 4; length -= 4, pos += 32)
+            writeBitsToHalftrack(ht, pos, 0x55555555, 32);
+        writeBitsToHalftrack(ht, pos, 0x55555555, 8 * (unsigned)length);
     }
     
     void writeGapToTrack(Track t, HeadPosition pos, size_t length) {
@@ -457,7 +541,7 @@ public:
 private:
     
     //! @brief    Returns a textual representation
-    const char *sectorBytesAsString(uint8_t *buffer, size_t length);
+    const char *sectorBytesAsString(size_t offset, size_t length);
     
     
     //
@@ -475,15 +559,15 @@ public:
      */
     size_t decodeDisk(uint8_t *dest);
  
+    //! @brief   Decodes all sectors of a track
+    size_t decodeTrack(Track t, uint8_t *dest);
+
 private:
     
     /*! @brief   Work horse for decodeDisk(uint8_t *)
      *  @param   numTracks must be either 35, 40, or 42.
      */
     size_t decodeDisk(uint8_t *dest, unsigned numTracks);
-    
-    //! @brief   Decodes all sectors of a track
-    size_t decodeTrack(Track t, uint8_t *dest);
 
     //! @brief   Decodes a single sector
     size_t decodeSector(size_t offset, uint8_t *dest);
@@ -503,7 +587,9 @@ public:
         
     /*! @brief   Converts a D64 archive into a floppy disk.
      *  @details The method creates sync marks, GRC encoded header and data
-     *           blocks, checksums and gaps.
+     *           blocks, checksums and gaps. The track lengths are set up
+     *           immediately, but the tracks themselves are encoded lazily
+     *           when their data is accessed for the first time.
      *  @param   alignTracks If true, the first sector always starts at the
      *           beginning of a track.
      */
@@ -512,8 +598,27 @@ public:
     //! @brief   Converts a D64 archive into a floppy disk.
     void encodeArchive(D64File *a) { encodeArchive(a, false); }
 
+    /*! @brief   Makes sure that the data of a halftrack is available
+     *  @details If the halftrack belongs to a D64 archive that has been
+     *           inserted lazily, the track gets encoded now.
+     */
+    void encodeIfPending(Halftrack ht) {
+        if (pending[ht].load(std::memory_order_acquire)) encodePendingHalftrack(ht); }
+    
+    //! @brief   Encodes all halftracks that have not been encoded yet
+    void encodePendingHalftracks();
+
 private:
     
+    //! @brief   Tail gap bytes written after each sector (per speed zone)
+    static const int tailGap[4];
+    
+    //! @brief   Length of D64 encoded tracks in bits (per speed zone)
+    static const uint16_t trackLength[4];
+    
+    //! @brief   Returns the start position of the first sector in a track
+    HeadPosition trackStart(Track t, bool alignTracks);
+    
     /*! @brief   Encode a single track
      *  @details This function translates the logical byte sequence of a single track into
      *           the native VC1541 byte representation. The native representation includes
@@ -526,6 +631,12 @@ private:
      */
     size_t encodeTrack(D64File *a, Track t, uint8_t tailGap, HeadPosition start);
     
+    //! @brief   Encodes a pending halftrack
+    void encodePendingHalftrack(Halftrack ht);
+    
+    //! @brief   Forgets about all pending halftracks
+    void discardPendingHalftracks();
+    
     /*! @brief   Encode a single sector
      *  @details This function translates the logical byte sequence of a single sector
      *           into the native VC1541 byte representation. The sector is closed by
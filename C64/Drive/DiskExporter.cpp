@@ -0,0 +1,398 @@
+/*!
+ * @file        DiskExporter.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "C64.h"
+
+void
+*exporterThread(void *thisExporter)
+{
+    assert(thisExporter != NULL);
+
+    DiskExporter *exporter = (DiskExporter *)thisExporter;
+    exporter->run();
+    pthread_exit(NULL);
+}
+
+DiskExporter::DiskExporter(Disk *disk)
+{
+    setDescription("DiskExporter");
+
+    assert(disk != NULL);
+    this->disk = disk;
+
+    memset(trackOffset, 0, sizeof(trackOffset));
+    memset(queuedLength, 0, sizeof(queuedLength));
+    memset(queued, 0, sizeof(queued));
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&workCond, NULL);
+    pthread_cond_init(&idleCond, NULL);
+}
+
+DiskExporter::~DiskExporter()
+{
+    // Terminate the exporter thread (queued halftracks are written first)
+    if (threadRunning) {
+        pthread_mutex_lock(&lock);
+        stopRequested = true;
+        pthread_cond_signal(&workCond);
+        pthread_mutex_unlock(&lock);
+        pthread_join(thread, NULL);
+    }
+
+    pthread_cond_destroy(&idleCond);
+    pthread_cond_destroy(&workCond);
+    pthread_mutex_destroy(&lock);
+
+    delete[] queuedData;
+    delete[] image;
+    delete scratch;
+}
+
+bool
+DiskExporter::attach(const char *path, C64FileType type)
+{
+    assert(path != NULL);
+    assert(type == D64_FILE || type == G64_FILE);
+
+    detach();
+
+    uint8_t *buffer = NULL;
+    size_t size = 0;
+
+    if (type == D64_FILE) {
+
+        // Decode the whole disk once
+        buffer = new uint8_t[D64_802_SECTORS];
+        size = disk->decodeDisk(buffer);
+
+        if (size != D64_683_SECTORS && size != D64_768_SECTORS && size != D64_802_SECTORS) {
+            warn("Cannot attach %s. The disk can't be decoded.\n", path);
+            delete[] buffer;
+            return false;
+        }
+
+    } else {
+
+        G64File *archive = G64File::makeWithDisk(disk);
+        if (archive == NULL) {
+            warn("Cannot attach %s. The disk can't be converted.\n", path);
+            return false;
+        }
+        size = archive->sizeOnDisk();
+        buffer = new uint8_t[size];
+        archive->writeToBuffer(buffer);
+        delete archive;
+
+        // Remember where the halftracks are stored
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+            trackOffset[ht] = LO_LO_HI_HI(buffer[8 + 4 * ht], buffer[9 + 4 * ht],
+                                          buffer[10 + 4 * ht], buffer[11 + 4 * ht]);
+        }
+    }
+
+    // Write the complete file
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || !writeToFile(file, 0, buffer, size)) {
+        warn("Cannot write to %s\n", path);
+        if (file) fclose(file);
+        delete[] buffer;
+        return false;
+    }
+    fclose(file);
+
+    if (type == D64_FILE) {
+        image = buffer;
+        imageSize = size;
+    } else {
+        delete[] buffer;
+    }
+    if (scratch == NULL) {
+        scratch = new Disk();
+    }
+
+    if (queuedData == NULL) {
+        queuedData = new uint8_t[85][maxBytesOnTrack];
+    }
+
+    // Launch the exporter thread
+    if (!threadRunning) {
+        pthread_create(&thread, NULL, exporterThread, (void *)this);
+        threadRunning = true;
+    }
+
+    disk->setDirty(false);
+    this->path = path;
+    this->type = type;
+
+    debug(2, "Attached %s\n", path);
+    return true;
+}
+
+void
+DiskExporter::detach()
+{
+    if (!isAttached())
+        return;
+
+    waitUntilIdle();
+
+    debug(2, "Detached %s\n", path.c_str());
+
+    path.clear();
+    type = UNKNOWN_FILE_FORMAT;
+    delete[] image;
+    image = NULL;
+    imageSize = 0;
+    delete scratch;
+    scratch = NULL;
+    memset(trackOffset, 0, sizeof(trackOffset));
+}
+
+void
+DiskExporter::flush()
+{
+    if (!isAttached())
+        return;
+
+    unsigned numTracks = (unsigned)(imageSize / 256) == 683 ? 35 :
+                         (unsigned)(imageSize / 256) == 768 ? 40 : 42;
+
+    pthread_mutex_lock(&lock);
+
+    // Check if the file layout of a G64 file changes
+    bool rebuild = false;
+    if (type == G64_FILE) {
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+            if (disk->isDirty(ht) && trackOffset[ht] == 0) {
+                rebuild = true;
+                break;
+            }
+        }
+    }
+
+    if (rebuild) {
+
+        // Hand over a copy of all halftracks. The exporter thread creates a
+        // new G64 file from them.
+        disk->encodePendingHalftracks();
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+            disk->clearDirty(ht);
+            memcpy(queuedData[ht], disk->data.halftrack[ht], maxBytesOnTrack);
+            queuedLength[ht] = disk->lengthOfHalftrack(ht);
+            queued[ht] = false;
+        }
+        numQueued = 0;
+        rebuildQueued = true;
+
+    } else {
+
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+
+            if (!disk->isDirty(ht))
+                continue;
+
+            disk->clearDirty(ht);
+
+            // D64 files only store full tracks
+            if (type == D64_FILE && (ht % 2 == 0 || (ht + 1) / 2 > numTracks))
+                continue;
+
+            memcpy(queuedData[ht], disk->data.halftrack[ht], maxBytesOnTrack);
+            queuedLength[ht] = disk->lengthOfHalftrack(ht);
+            if (!queued[ht] && !rebuildQueued) {
+                queued[ht] = true;
+                numQueued++;
+            }
+        }
+    }
+
+    // Wake up the exporter thread
+    pthread_cond_signal(&workCond);
+    pthread_mutex_unlock(&lock);
+}
+
+void
+DiskExporter::waitUntilIdle()
+{
+    if (!threadRunning)
+        return;
+
+    pthread_mutex_lock(&lock);
+    while (busy || numQueued || rebuildQueued) {
+        pthread_cond_signal(&workCond);
+        pthread_cond_wait(&idleCond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void
+DiskExporter::run()
+{
+    uint8_t data[maxBytesOnTrack];
+
+    debug(2, "Exporter thread started\n");
+
+    pthread_mutex_lock(&lock);
+
+    while (1) {
+
+        // Sleep until there is something to do
+        while (numQueued == 0 && !rebuildQueued && !stopRequested) {
+            busy = false;
+            pthread_cond_broadcast(&idleCond);
+            pthread_cond_wait(&workCond, &lock);
+        }
+        if (numQueued == 0 && !rebuildQueued) {
+            break;
+        }
+        busy = true;
+
+        if (rebuildQueued) {
+            rebuild();
+            continue;
+        }
+
+        // Take all queued halftracks in one go
+        FILE *file = fopen(path.c_str(), "r+b");
+        if (file == NULL) {
+            warn("Cannot open %s\n", path.c_str());
+        }
+
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+
+            if (!queued[ht])
+                continue;
+
+            memcpy(data, queuedData[ht], maxBytesOnTrack);
+            uint16_t length = queuedLength[ht];
+            uint32_t offset = trackOffset[ht];
+            queued[ht] = false;
+            numQueued--;
+
+            pthread_mutex_unlock(&lock);
+            if (file) writeBack(file, ht, data, length, offset);
+            pthread_mutex_lock(&lock);
+        }
+
+        if (file) fclose(file);
+    }
+
+    busy = false;
+    pthread_cond_broadcast(&idleCond);
+    pthread_mutex_unlock(&lock);
+
+    debug(2, "Exporter thread terminated\n");
+}
+
+void
+DiskExporter::writeBack(FILE *file, Halftrack ht, uint8_t *data, uint16_t length,
+                        uint32_t offset)
+{
+    assert(isHalftrackNumber(ht));
+
+    if (type == D64_FILE) {
+
+        uint8_t buffer[256 * 21];
+        Track t = (ht + 1) / 2;
+        size_t expected = 256 * numberOfSectorsInTrack(t);
+
+        // Decode the track with the help of the scratch disk
+        memcpy(scratch->data.halftrack[ht], data, maxBytesOnTrack);
+        scratch->length.halftrack[ht] = length;
+        if (scratch->decodeTrack(t, buffer) != expected) {
+            warn("Track %d can't be decoded. Skipping it.\n", t);
+            return;
+        }
+
+        size_t offset = 256 * Disk::trackDefaults[t].firstSectorNr;
+        memcpy(image + offset, buffer, expected);
+        writeToFile(file, offset, buffer, expected);
+        debug(2, "Wrote back track %d\n", t);
+
+    } else {
+
+        // Assemble the G64 track entry (length, data, fill bytes)
+        uint8_t buffer[2 + maxBytesOnTrack];
+        uint16_t numDataBytes = length / 8;
+
+        buffer[0] = LO_BYTE(numDataBytes);
+        buffer[1] = HI_BYTE(numDataBytes);
+        memcpy(buffer + 2, data, numDataBytes);
+        memset(buffer + 2 + numDataBytes, 0xFF, maxBytesOnTrack - numDataBytes);
+
+        writeToFile(file, offset, buffer, sizeof(buffer));
+        debug(2, "Wrote back halftrack %d\n", ht);
+    }
+}
+
+void
+DiskExporter::rebuild()
+{
+    // Take over the queued halftracks
+    for (Halftrack ht = 1; ht <= 84; ht++) {
+        memcpy(scratch->data.halftrack[ht], queuedData[ht], maxBytesOnTrack);
+        scratch->length.halftrack[ht] = queuedLength[ht];
+    }
+    rebuildQueued = false;
+    pthread_mutex_unlock(&lock);
+
+    // Convert the disk
+    uint8_t *buffer = NULL;
+    size_t size = 0;
+    G64File *archive = G64File::makeWithDisk(scratch);
+    if (archive) {
+        size = archive->sizeOnDisk();
+        buffer = new uint8_t[size];
+        archive->writeToBuffer(buffer);
+        delete archive;
+    }
+
+    // Replace the whole file
+    FILE *file = buffer ? fopen(path.c_str(), "wb") : NULL;
+    if (file == NULL || !writeToFile(file, 0, buffer, size)) {
+        warn("Failed to rebuild %s\n", path.c_str());
+    }
+    if (file) fclose(file);
+    debug(2, "Rebuilt %s\n", path.c_str());
+
+    pthread_mutex_lock(&lock);
+
+    // Remember where the halftracks are stored now
+    if (buffer) {
+        for (Halftrack ht = 1; ht <= 84; ht++) {
+            trackOffset[ht] = LO_LO_HI_HI(buffer[8 + 4 * ht], buffer[9 + 4 * ht],
+                                          buffer[10 + 4 * ht], buffer[11 + 4 * ht]);
+        }
+    }
+    delete[] buffer;
+}
+
+bool
+DiskExporter::writeToFile(FILE *file, size_t offset, uint8_t *buffer, size_t length)
+{
+    if (fseek(file, (long)offset, SEEK_SET) != 0 ||
+        fwrite(buffer, 1, length, file) != length) {
+        warn("Failed to write %zu bytes at offset %zu\n", length, offset);
+        return false;
+    }
+    return true;
+}
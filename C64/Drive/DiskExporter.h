@@ -0,0 +1,199 @@
+/*!
+ * @header      DiskExporter.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _DISKEXPORTER_H
+#define _DISKEXPORTER_H
+
+#include "VC64Object.h"
+#include "File_types.h"
+#include "Disk.h"
+#include <string>
+#include <pthread.h>
+
+/*! @brief    Writes the contents of a disk back into a D64 or G64 file
+ *  @details  Once a backing file has been attached, the exporter keeps it in
+ *            sync with the disk. Only the halftracks that have been written
+ *            to are processed. The emulator thread merely copies the raw
+ *            data of these halftracks. Decoding them and writing the result
+ *            into the backing file is done on a separate thread.
+ */
+class DiskExporter : public VC64Object {
+
+    //! @brief    The disk to export
+    Disk *disk;
+
+    //! @brief    Path of the backing file (empty if no file is attached)
+    std::string path;
+
+    //! @brief    Format of the backing file (D64_FILE or G64_FILE)
+    C64FileType type = UNKNOWN_FILE_FORMAT;
+
+
+    //
+    // D64 export
+    //
+
+    /*! @brief    Copy of the D64 file contents
+     *  @details  Decoded tracks are written into this buffer before they are
+     *            written into the backing file.
+     */
+    uint8_t *image = NULL;
+
+    //! @brief    Number of bytes in the D64 image
+    size_t imageSize = 0;
+
+    /*! @brief    Scratch disk used by the exporter thread
+     *  @details  Decoding a track or converting a disk into a G64 file
+     *            requires a disk object. The exporter thread uses its own one
+     *            to stay clear of the emulated disk.
+     */
+    Disk *scratch = NULL;
+
+
+    //
+    // G64 export
+    //
+
+    //! @brief    File offset of each halftrack (0 = halftrack is not stored)
+    uint32_t trackOffset[85];
+
+    /*! @brief    Indicates that the G64 file has to be rebuilt from scratch
+     *  @details  This is necessary if an empty halftrack has been written to,
+     *            because the file layout changes. If set, the work queue
+     *            contains a copy of all halftracks. The exporter thread
+     *            converts them into a new G64 file.
+     */
+    bool rebuildQueued = false;
+
+
+    //
+    // Work queue
+    //
+
+    //! @brief    Raw data of the halftracks that need to be written back
+    uint8_t (*queuedData)[maxBytesOnTrack] = NULL;
+
+    //! @brief    Length of the queued halftracks in bits
+    uint16_t queuedLength[85];
+
+    //! @brief    Indicates which halftracks are queued for writing back
+    bool queued[85];
+
+    //! @brief    Number of halftracks in the queue
+    unsigned numQueued = 0;
+
+    //! @brief    Indicates that the exporter thread is busy
+    bool busy = false;
+
+
+    //
+    // Thread management
+    //
+
+    //! @brief    The exporter thread
+    pthread_t thread;
+
+    //! @brief    Indicates whether the exporter thread has been launched
+    bool threadRunning = false;
+
+    //! @brief    Asks the exporter thread to terminate
+    bool stopRequested = false;
+
+    //! @brief    Mutex protecting the work queue
+    pthread_mutex_t lock;
+
+    //! @brief    Signals new work to the exporter thread
+    pthread_cond_t workCond;
+
+    //! @brief    Signals that the exporter thread has run out of work
+    pthread_cond_t idleCond;
+
+public:
+
+    //! @brief    Constructor
+    DiskExporter(Disk *disk);
+
+    //! @brief    Destructor
+    /*! @details  Writes back all queued halftracks and terminates the thread.
+     */
+    ~DiskExporter();
+
+
+    //
+    //! @functiongroup Managing the backing file
+    //
+
+    /*! @brief    Attaches a backing file
+     *  @details  The complete disk is exported once and written to the
+     *            specified file. From then on, modified halftracks are written
+     *            back incrementally. The emulator must not run while this
+     *            function is executed.
+     *  @param    type D64_FILE or G64_FILE
+     *  @return   false, if the disk could not be exported
+     */
+    bool attach(const char *path, C64FileType type);
+
+    /*! @brief    Detaches the backing file
+     *  @details  Pending write-backs are completed before.
+     */
+    void detach();
+
+    //! @brief    Returns true if a backing file is attached
+    bool isAttached() { return !path.empty(); }
+
+    //! @brief    Returns the path of the backing file
+    const char *getPath() { return path.c_str(); }
+
+
+    //
+    //! @functiongroup Writing back modified tracks
+    //
+
+    /*! @brief    Hands all modified halftracks over to the exporter thread
+     *  @details  This function copies the raw data of all dirty halftracks
+     *            and clears their dirty flags. It is executed by the emulator
+     *            thread and returns immediately.
+     */
+    void flush();
+
+    //! @brief    Waits until all handed over halftracks have been written
+    void waitUntilIdle();
+
+    //! @brief    The thread function
+    void run();
+
+private:
+
+    /*! @brief    Writes a single halftrack into the backing file
+     *  @param    offset File offset of the halftrack (G64 files only)
+     */
+    void writeBack(FILE *file, Halftrack ht, uint8_t *data, uint16_t length, uint32_t offset);
+
+    //! @brief    Writes a byte sequence into the backing file
+    bool writeToFile(FILE *file, size_t offset, uint8_t *buffer, size_t length);
+    
+    /*! @brief    Rebuilds the G64 file from the queued halftracks
+     *  @details  Called by the exporter thread with the lock held. The lock
+     *            is released while the file is converted and written.
+     */
+    void rebuild();
+};
+
+#endif
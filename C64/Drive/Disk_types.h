@@ -174,20 +174,18 @@ typedef struct {
 } SectorInfo;
 
 //! @brief    Information about a single track as gathered by analyzeTrack()
-/*! @note     To provide a fast access, the the track data is stored as a byte stream.
- *            Each byte represents a single bit and is either 0 or 1. The stored sequence
- *            is repeated twice to ease the handling of wrap arounds.
+/*! @note     The track data is stored as a packed bit stream, starting with
+ *            the most significant bit of the first byte. The stored sequence
+ *            is repeated twice to ease the handling of wrap arounds. The
+ *            second copy starts at bit offset 'length'.
  */
 typedef struct {
     
     // Length of the track in bits
     size_t length;
     
-    // Track data
-    union {
-        uint8_t bit[2 * maxBitsOnTrack];
-        uint64_t byte[2 * maxBytesOnTrack];
-    };
+    // Track data (padded to allow 64 bit reads at any offset)
+    uint8_t bits[2 * maxBytesOnTrack + 16];
 
     // Sector layout data
     SectorInfo sectorInfo[22];
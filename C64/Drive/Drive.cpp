@@ -30,6 +30,8 @@ VC1541::VC1541(unsigned nr)
     cpu.setDescription(deviceNr == 1 ? "Drive1CPU" : "Drive2CPU");
     debug(3, "Creating %s at address %p\n", getDescription());
 	
+    exporter = new DiskExporter(&disk);
+    
     // Register sub components
     VirtualComponent *subcomponents[] = { &mem, &cpu, &via1, &via2, &disk, NULL };
     registerSubComponents(subcomponents, sizeof(subcomponents));
@@ -74,6 +76,7 @@ VC1541::VC1541(unsigned nr)
 VC1541::~VC1541()
 {
 	debug(3, "Releasing VC1541...\n");
+    delete exporter;
 }
 
 void
@@ -91,6 +94,7 @@ VC1541::resetDisk()
     debug (3, "Resetting disk in VC1541...\n");
     
     disk.clearDisk();
+    invalidateReadWindow();
 }
 
 void
@@ -106,6 +110,20 @@ VC1541::ping()
 
 }
 
+void
+VC1541::willLoadFromBuffer(uint8_t **buffer)
+{
+    // Rolling back a run-ahead frame restores the disk we already have
+    if (c64->isRunningAhead() || !exporter->isAttached())
+        return;
+    
+    // Other snapshots may contain a different disk that must not end up in
+    // the backing file. Write back the current disk and detach the file.
+    warn("Restoring a snapshot. Detaching the backing file.\n");
+    exporter->flush();
+    exporter->detach();
+}
+
 void
 VC1541::setClockFrequency(uint32_t frequency)
 {
@@ -113,6 +131,20 @@ VC1541::setClockFrequency(uint32_t frequency)
     debug("Duration a CPU cycle is %lld 1/10 nsec.\n", durationOfOneCpuCycle);
 }
 
+uint64_t
+VC1541::fingerprint()
+{
+    uint64_t result = fnv_1a_64(mem.ram, sizeof(mem.ram));
+    
+    result = fnv_1a_it64(result, cpu.fingerprint());
+    result = fnv_1a_it64(result, via1.fingerprint());
+    result = fnv_1a_it64(result, via2.fingerprint());
+    result = fnv_1a_it64(result, halftrack);
+    result = fnv_1a_it64(result, offset);
+    
+    return result;
+}
+
 void 
 VC1541::dump()
 {
@@ -215,7 +247,7 @@ VC1541::executeUF4()
         // When a bit comes in and ...
         //   ... it's value equals 0, nothing happens.
         //   ... it's value equals 1, counter UF4 is reset.
-        if (readMode() && readBitFromHead()) {
+        if (readMode() && readBitFromWindow()) {
             counterUF4 = 0;
         }
         rotateDisk();
@@ -295,6 +327,36 @@ VC1541::executeUF4()
     }
 }
 
+void
+VC1541::fillReadWindow()
+{
+    uint16_t length = disk.lengthOfHalftrack(halftrack);
+    
+    readWindowHalftrack = halftrack;
+    readWindowOffset = offset;
+    
+    // If the head is out of bounds, let the disk wrap the position around
+    if (offset < 0 || offset >= length) {
+        readWindow = (uint64_t)readBitFromHead() << 63;
+        readWindowBits = 1;
+        return;
+    }
+    
+    // Fetch up to 56 bits (at most 8 bytes) without crossing the track end
+    disk.encodeIfPending(halftrack);
+    uint8_t *data = disk.data.halftrack[halftrack];
+    unsigned bits = MIN(length - offset, 56);
+    unsigned first = offset / 8;
+    unsigned last = (offset + bits - 1) / 8;
+    
+    uint64_t window = 0;
+    for (unsigned i = first, shift = 56; i <= last; i++, shift -= 8) {
+        window |= (uint64_t)data[i] << shift;
+    }
+    readWindow = window << (offset % 8);
+    readWindowBits = bits;
+}
+
 void
 VC1541::updateByteReady()
 {
@@ -405,6 +467,11 @@ VC1541::setRotating(bool b)
     } else if (spinning && !b) {
         spinning = false;
         c64->putMessage(MSG_VC1541_MOTOR_OFF, deviceNr);
+        
+        // Write back modified tracks (unless this is a speculative frame
+        // that will be rolled back)
+        if (!c64->isRunningAhead())
+            exporter->flush();
     }
 }
 
@@ -482,6 +549,8 @@ VC1541::insertDisk(AnyArchive *a)
     assert(a != NULL);
     assert(insertionStatus == PARTIALLY_INSERTED);
     
+    exporter->detach();
+    
     switch (a->type()) {
             
         case D64_FILE:
@@ -502,9 +571,11 @@ VC1541::insertDisk(AnyArchive *a)
             D64File *converted = D64File::makeWithAnyArchive(a);
             disk.clearDisk();
             disk.encodeArchive(converted);
+            delete converted;
             break;
         }
     }
+    invalidateReadWindow();
     
     insertionStatus = FULLY_INSERTED;
     
@@ -527,8 +598,13 @@ VC1541::prepareToEject()
     // Block the light barrier by taking the disk half out
     insertionStatus = PARTIALLY_INSERTED;
     
+    // Write back modified tracks before the data is gone
+    exporter->flush();
+    exporter->detach();
+    
     // Make sure the drive can no longer read from this disk
     disk.clearDisk();
+    invalidateReadWindow();
     
     resume();
 }
@@ -552,3 +628,37 @@ VC1541::ejectDisk()
     resume();
 }
 
+bool
+VC1541::attachBackingFile(const char *path, C64FileType type)
+{
+    bool result = false;
+    
+    suspend();
+    
+    if (hasDisk()) {
+        result = exporter->attach(path, type);
+    } else {
+        warn("Cannot attach a backing file. No disk inserted.\n");
+    }
+    
+    resume();
+    return result;
+}
+
+void
+VC1541::detachBackingFile()
+{
+    suspend();
+    exporter->flush();
+    exporter->detach();
+    resume();
+}
+
+void
+VC1541::writeBackDisk()
+{
+    suspend();
+    exporter->flush();
+    exporter->waitUntilIdle();
+    resume();
+}
@@ -32,6 +32,7 @@
 
 #include "VIA.h"
 #include "Disk.h"
+#include "DiskExporter.h"
 
 /*!
  * @brief    A Commodore VC 1541 disk drive
@@ -81,6 +82,9 @@ public:
     //! @brief    A single sided 5,25" floppy disk
     Disk disk;
     
+    //! @brief    Writes modified disk tracks back into a D64 or G64 file
+    DiskExporter *exporter;
+    
     
     //
     // Drive status
@@ -222,6 +226,29 @@ public:
      */
     bool byteReady;
     
+    
+    //
+    // Read cache
+    //
+    
+    /*! @brief    Disk data ahead of the drive head
+     *  @details  In read mode, the drive head fetches its bits from this
+     *            window instead of accessing the disk bit by bit. The most
+     *            significant bit is the bit under the drive head. The window
+     *            is refilled a byte at a time from the halftrack data whenever
+     *            it runs empty or the head has been moved by other means than
+     *            rotating the disk in read mode. It is no part of the snapshot
+     *            and rebuilt on demand.
+     */
+    uint64_t readWindow = 0;
+    
+    //! @brief    Number of valid bits in readWindow
+    unsigned readWindowBits = 0;
+    
+    //! @brief    Head position of the most significant bit in readWindow
+    Halftrack readWindowHalftrack = 0;
+    HeadPosition readWindowOffset = 0;
+    
     public:
 
     //
@@ -243,8 +270,16 @@ public:
 
     void reset();
     void ping();
+    void willLoadFromBuffer(uint8_t **buffer);
+    void didLoadFromBuffer(uint8_t **buffer) { invalidateReadWindow(); }
     void dump();
     void setClockFrequency(uint32_t frequency);
+    
+    /*! @brief    Method from VirtualComponent
+     *  @details  The fingerprint covers the drive CPU, both VIAs, the drive
+     *            RAM, and the head position. The disk contents are excluded.
+     */
+    uint64_t fingerprint();
 
     /*! @brief    Resets all disk related properties
      *  @note     This method is needed, because reset() keeps the disk alive.
@@ -370,6 +405,25 @@ public:
      */
     void ejectDisk();
    
+    /*! @brief    Attaches a backing file to the inserted disk
+     *  @details  The disk is exported into the specified file. Whenever the
+     *            drive motor stops, all modified tracks are written back.
+     *  @param    type D64_FILE or G64_FILE
+     *  @return   false, if the disk could not be exported
+     */
+    bool attachBackingFile(const char *path, C64FileType type);
+    
+    //! @brief    Detaches the backing file after writing back all modified tracks
+    void detachBackingFile();
+    
+    //! @brief    Returns true if the inserted disk has a backing file
+    bool hasBackingFile() { return exporter->isAttached(); }
+    
+    /*! @brief    Writes back all modified tracks into the backing file
+     *  @details  The function waits until the file has been updated.
+     */
+    void writeBackDisk();
+    
     
     //
     //! @functiongroup Running the device
@@ -456,8 +510,31 @@ public:
      */
     uint8_t readBitFromHead() { return disk.readBitFromHalftrack(halftrack, offset); }
     
+    /*! @brief    Reads a single bit from the disk head via the read window
+     *  @details  Delivers the same bit as readBitFromHead(), but touches the
+     *            disk data only once every 56 bits.
+     *  @result   0 or 1
+     */
+    uint8_t readBitFromWindow() {
+        if (readWindowBits == 0 ||
+            readWindowOffset != offset || readWindowHalftrack != halftrack) {
+            fillReadWindow();
+        }
+        uint8_t bit = (uint8_t)(readWindow >> 63);
+        readWindow <<= 1;
+        readWindowBits--;
+        readWindowOffset++;
+        return bit; }
+    
+    //! @brief    Refills the read window at the current head position
+    void fillReadWindow();
+    
+    //! @brief    Discards the contents of the read window
+    void invalidateReadWindow() { readWindowBits = 0; }
+    
     //! @brief Writes a single bit to the disk head
     void writeBitToHead(uint8_t bit) {
+        invalidateReadWindow();
         disk.writeBitToHalftrack(halftrack, offset, bit); }
     
     //! @brief  Advances drive head position by one bit
@@ -45,7 +45,13 @@ AnyC64File::dealloc()
         return;
     }
     
-    delete[] data;
+    if (data == mapping) {
+        munmap(mapping, mappingSize);
+        mapping = NULL;
+        mappingSize = 0;
+    } else {
+        delete[] data;
+    }
     data = NULL;
     size = 0;
     fp = -1;
@@ -158,10 +164,20 @@ AnyC64File::readFromBuffer(const uint8_t *buffer, size_t length)
     assert (buffer != NULL);
     
     dealloc();
-    if ((data = new uint8_t[length]) == NULL)
-        return false;
     
-    memcpy(data, buffer, length);
+    if (buffer == mapping) {
+        
+        // Adopt the memory mapped file (no need to copy anything)
+        assert(length == mappingSize);
+        data = mapping;
+        
+    } else {
+        
+        if ((data = new uint8_t[length]) == NULL)
+            return false;
+        
+        memcpy(data, buffer, length);
+    }
     size = length;
     eof = length;
     fp = 0;
@@ -175,55 +191,77 @@ AnyC64File::readFromFile(const char *filename)
     
     bool success = false;
 	uint8_t *buffer = NULL;
-	FILE *file = NULL;
+	int fd = -1;
 	struct stat fileProperties;
+	size_t length;
 	
 	// Check file type
     if (!hasSameType(filename)) {
 		goto exit;
 	}
 	
-	// Get file properties
-    if (stat(filename, &fileProperties) != 0) {
-		goto exit;
-	}
-		
 	// Open file
-	if (!(file = fopen(filename, "r"))) {
+	if ((fd = open(filename, O_RDONLY)) < 0) {
 		goto exit;
 	}
 
-	// Allocate memory
-	if (!(buffer = new uint8_t[fileProperties.st_size])) {
+	// Get file properties
+    if (fstat(fd, &fileProperties) != 0) {
 		goto exit;
 	}
+	length = (size_t)fileProperties.st_size;
 	
-	// Read from file
-	int c;
-	for (unsigned i = 0; i < fileProperties.st_size; i++) {
-		c = fgetc(file);
-		if (c == EOF)
-			break;
-		buffer[i] = (uint8_t)c;
+	dealloc();
+	
+	// Map file into memory (modifications are private to this process)
+	if (length > 0) {
+		void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			mapping = buffer = (uint8_t *)map;
+			mappingSize = length;
+		}
+	}
+	
+	// If mapping is not possible, read the file into a temporary buffer
+	if (buffer == NULL) {
+		
+		if (!(buffer = new uint8_t[length])) {
+			goto exit;
+		}
+		
+		for (size_t i = 0; i < length; ) {
+			ssize_t count = ::read(fd, buffer + i, length - i);
+			if (count <= 0) {
+				length = i;
+				break;
+			}
+			i += count;
+		}
 	}
 	
 	// Read from buffer (subclass specific behaviour)
-	dealloc();
-	if (!readFromBuffer(buffer, (unsigned)fileProperties.st_size)) {
+	if (!readFromBuffer(buffer, length)) {
 		goto exit;
 	}
 
     setPath(filename);
     success = true;
     
-    debug(1, "File %s read successfully\n", path);
+    debug(1, "File %s read successfully (%s)\n", path,
+          data == mapping ? "memory mapped" : "copied");
 	
 exit:
 	
-    if (file)
-		fclose(file);
-	if (buffer)
+	// Release the temporary buffer or the mapping if it hasn't been adopted
+	if (buffer && buffer != mapping)
 		delete[] buffer;
+	if (mapping && data != mapping) {
+		munmap(mapping, mappingSize);
+		mapping = NULL;
+		mappingSize = 0;
+	}
+	if (fd >= 0)
+		close(fd);
 
 	return success;
 }
@@ -47,9 +47,30 @@ protected:
      */
     unsigned short unicode[256];
     
-    //! @brief    The raw data of this file.
+    /*! @brief    The raw data of this file.
+     *  @details  If the file has been read by readFromFile(), this pointer
+     *            usually refers to a private memory mapping of the file.
+     *  @see      mapping
+     */
     uint8_t *data = NULL;
     
+    /*! @brief    Memory mapping of the file on disk
+     *  @details  readFromFile() maps the file copy-on-write (MAP_PRIVATE)
+     *            instead of reading it into a buffer. If the subclass adopts
+     *            the mapping in readFromBuffer(), data points to it and the
+     *            file contents are parsed in place. Modifications only affect
+     *            the touched pages which are copied by the operating system.
+     *            The file on disk is never changed.
+     *  @note     The mapping is only valid as long as the file on disk keeps
+     *            its size. If the file is truncated while it is mapped,
+     *            accessing the truncated pages raises SIGBUS. Subclasses
+     *            whose data outlives the file object (CRTFile) copy it.
+     */
+    uint8_t *mapping = NULL;
+    
+    //! @brief    Size of the memory mapping in bytes.
+    size_t mappingSize = 0;
+    
     //! @brief    The size of this file in bytes.
     size_t size = 0;
     
@@ -167,6 +188,9 @@ public:
     virtual bool hasSameType(const char *filename) { return false; }
 
     /*! @brief    Reads the file contents from a memory buffer.
+     *  @details  The buffer contents are copied, unless the buffer is the
+     *            memory mapping created by readFromFile(). In that case, the
+     *            mapping is adopted as data buffer.
      *  @param    buffer The address of a binary representation in memory.
      *  @param    length The size of the binary representation.
      */
@@ -174,8 +198,9 @@ public:
 	
     /*! @brief    Reads the file contents from a file.
      *  @details  This function requires no custom implementation. It first
-     *            reads in the file contents in memory and invokes
-     *            readFromBuffer afterwards.
+     *            maps the file contents into memory and invokes
+     *            readFromBuffer afterwards. If the file cannot be mapped, it
+     *            is read into a temporary buffer instead.
      *  @param    filename The name of a file on disk.
      */
 	bool readFromFile(const char *filename);
@@ -184,6 +184,14 @@ CRTFile::makeWithFile(const char *filename)
 void
 CRTFile::dealloc()
 {
+    // The data is owned by the shared storage
+    if (storage) {
+        storage.reset();
+        data = mapping = NULL;
+        size = mappingSize = 0;
+        fp = eof = -1;
+    }
+    
     AnyC64File::dealloc();
     memset(chips, 0, sizeof(chips));
     numberOfChips = 0;
@@ -195,6 +203,18 @@ CRTFile::readFromBuffer(const uint8_t *buffer, size_t length)
     if (!AnyC64File::readFromBuffer(buffer, length))
         return false;
     
+    // Rom chips stay attached as long as the cartridge is plugged in. We
+    // don't keep the memory mapping that long, because accessing it raises
+    // SIGBUS if the file gets truncated on disk in the meantime. The mapping
+    // itself is released by readFromFile().
+    if (data == mapping) {
+        data = new uint8_t[length];
+        memcpy(data, mapping, length);
+    }
+    
+    // Hand the data over to the shared storage
+    storage.reset(data, std::default_delete<uint8_t[]>());
+    
     // Only proceed if the cartridge header matches
     if (memcmp("C64 CARTRIDGE   ", data, 16) != 0) {
         warn("Bad cartridge signature. Expected 'C64  CARTRIDGE  '\n");
@@ -31,6 +31,7 @@
 #define _CRTFILE_INC
 
 #include "AnyC64File.h"
+#include <memory>
 
 /*! @class    CRTFile
  *  @brief    Represents a file of the CRT format type (cartridges).
@@ -50,6 +51,14 @@ private:
     
     //! @brief    Indicates where each chip section starts
     uint8_t *chips[MAX_PACKETS];
+    
+    /*! @brief    Reference counted owner of the file data
+     *  @details  Rom chips created from this file reference the chip data
+     *            directly. The data is released when the file and all chips
+     *            referencing it have been deleted.
+     *  @see      chipStorage()
+     */
+    std::shared_ptr<uint8_t> storage;
 
 public:
     
@@ -86,6 +95,9 @@ public:
     //! @brief    Constructor
     CRTFile();
     
+    //! @brief    Destructor
+    ~CRTFile() { dealloc(); }
+    
     //! @brief    Factory method
     static CRTFile *makeWithBuffer(const uint8_t *buffer, size_t length);
 
@@ -137,6 +149,10 @@ public:
     //! @brief    Returns where the data of a certain chip can be found
     uint8_t *chipData(unsigned nr) { return chips[nr]+0x10; }
     
+    //! @brief    Returns a shared reference to the data of a certain chip
+    std::shared_ptr<uint8_t> chipStorage(unsigned nr) {
+        return std::shared_ptr<uint8_t>(storage, chipData(nr)); }
+    
     //! @brief    Returns the size of chip (8 KB or 16 KB)
     uint16_t chipSize(unsigned nr) { return LO_HI(chips[nr][0xF], chips[nr][0xE]); }
     
@@ -269,6 +269,7 @@ D64File::readFromBuffer(const uint8_t *buffer, size_t length)
     }
     
     AnyC64File::readFromBuffer(buffer, length);
+    invalidateDirectoryIndex();
     
     // Copy error codes into seperate array
     if (errorCodes) {
@@ -281,12 +282,10 @@ D64File::readFromBuffer(const uint8_t *buffer, size_t length)
 int
 D64File::numberOfItems()
 {
-    long offsets[144]; // A C64 disk contains at most 144 files
-    unsigned noOfFiles;
-    
-    scanDirectory(offsets, &noOfFiles);
+    if (numIndexedItems < 0)
+        buildDirectoryIndex();
     
-    return noOfFiles;
+    return numIndexedItems;
 }
 
 void
@@ -300,7 +299,7 @@ D64File::selectItem(unsigned item)
     selectedItem = item;
     
     // Move file pointer to the first data byte
-    iFp = findItem(item);
+    iFp = directory[item].start;
 }
 
 const char *
@@ -309,10 +308,10 @@ D64File::getTypeOfItemAsString()
     assert(selectedItem != -1);
     
     const char *extension = "";
-    long pos = findDirectoryEntry(selectedItem);
+    DirectoryItem *item = indexedItem(selectedItem);
     
-    if (pos > 0)
-        (void)itemIsVisible(data[pos] /* file type byte */, &extension);
+    if (item)
+        (void)itemIsVisible(item->typeChar, &extension);
     
     return extension;
 }
@@ -322,39 +321,15 @@ D64File::getNameOfItem()
 {
     assert(selectedItem != -1);
     
-    long pos;
-    int i;
-    
-    // Search the selected item in directory
-    if ((pos = findDirectoryEntry(selectedItem)) <= 0)
-        return NULL;
-    
-    pos += 0x03; // The filename begins here
-    for (i = 0; i < 16; i++) {
-        if (data[pos+i] == 0xA0)
-            break;
-        name[i] = data[pos+i];
-    }
-    name[i] = 0x00;
-    return name;
+    DirectoryItem *item = indexedItem(selectedItem);
+    return item ? item->name : NULL;
 }
 
 size_t
 D64File::getSizeOfItem()
 {
-    if (selectedItem < 0)
-        return 0;
-    
-    // In a D64 archive, the bytes of a single file item are not ordered
-    // consecutively. Hence, we have to step through the data byte by byte.
-    long oldFp = iFp;
-    size_t result = 0;
-    
-    while (readItem() != EOF)
-        result++;
-    
-    iFp = oldFp;
-    return result;
+    DirectoryItem *item = indexedItem(selectedItem);
+    return item ? item->sizeInBytes : 0;
 }
 
 size_t
@@ -362,8 +337,8 @@ D64File::getSizeOfItemInBlocks()
 {
     assert(selectedItem != -1);
     
-    long pos = findDirectoryEntry(selectedItem);
-    return (pos > 0) ? LO_HI(data[pos+0x1C],data[pos+0x1D]) : 0;
+    DirectoryItem *item = indexedItem(selectedItem);
+    return item ? item->sizeInBlocks : 0;
 }
 
 void
@@ -418,51 +393,89 @@ D64File::readItem()
 uint16_t
 D64File::getDestinationAddrOfItem()
 {
-    int track;
-    int sector;
-    uint16_t result;
-    
     assert(selectedItem != -1);
     
-    // Search for beginning of file data
-    long pos = findDirectoryEntry(selectedItem);
-    if (pos <= 0)
-        return 0;
-    
-    track = data[pos + 0x01];
-    sector = data[pos + 0x02];
-    if ((pos = offset(track, sector)) < 0)
-        return 0;
-    
-    result = LO_HI(data[pos+2],data[pos+3]);
-    return result;
+    DirectoryItem *item = indexedItem(selectedItem);
+    return item ? item->loadAddr : 0;
 }
 
 long
 D64File::findItem(long item)
 {
-    long p;
-    
-    if (item < 0)
-        return -1;
-    
-    // Find directory entry
-    if ((p = findDirectoryEntry(item)) <= 0)
-        return -1;
-    
-    // Find first data sector
-    if ((p = offset(data[p+0x01], data[p+0x02])) < 0)
-        return -1;
+    DirectoryItem *entry = indexedItem(item);
+    return entry ? entry->start : -1;
+}
+
+void
+D64File::buildDirectoryIndex()
+{
+    long offsets[144];
+    unsigned noOfFiles;
     
-    // Skip t/s sequence
-    p += 2;
+    scanDirectory(offsets, &noOfFiles);
     
-    // Skip destination address
-    p += 2;
+    for (unsigned i = 0; i < noOfFiles; i++) {
+        
+        DirectoryItem *item = &directory[i];
+        long pos = offsets[i];
+        int j;
+        
+        item->entry = pos;
+        item->typeChar = data[pos];
+        item->firstTrack = data[pos + 0x01];
+        item->firstSector = data[pos + 0x02];
+        item->sizeInBlocks = LO_HI(data[pos + 0x1C], data[pos + 0x1D]);
+        
+        // The filename begins at offset 3
+        for (j = 0; j < 16 && data[pos + 0x03 + j] != 0xA0; j++)
+            item->name[j] = data[pos + 0x03 + j];
+        item->name[j] = 0x00;
+        
+        item->start = -1;
+        item->sizeInBytes = 0;
+        item->chainLength = 0;
+        item->loadAddr = 0;
+        
+        if ((pos = offset(item->firstTrack, item->firstSector)) < 0)
+            continue;
+        
+        // The first data sector starts with the t/s link and the load address
+        item->loadAddr = LO_HI(data[pos + 2], data[pos + 3]);
+        item->start = pos + 4;
+        
+        // Follow the sector chain. We count the bytes in the same way as
+        // readItem() delivers them. A chain that is longer than the disk
+        // must contain a loop and is cut off.
+        long first = pos + 4;
+        while (item->chainLength++ < 802) {
+            
+            uint8_t t = data[pos], s = data[pos + 1];
+            
+            // Does the file end in this sector?
+            if (t == 0 && s >= first % 256) {
+                item->sizeInBytes += s - first % 256 + 1;
+                break;
+            }
+            item->sizeInBytes += 256 - first % 256;
+            
+            // Continue in the next sector
+            if (!jumpToNextSector(&pos))
+                break;
+            first = pos + 2;
+        }
+    }
     
-    return p;
+    numIndexedItems = noOfFiles;
 }
 
+D64File::DirectoryItem *
+D64File::indexedItem(long item)
+{
+    if (item < 0 || item >= numberOfItems())
+        return NULL;
+    
+    return &directory[item];
+}
 
 bool
 D64File::itemIsVisible(uint8_t typeChar, const char **extension)
@@ -692,6 +705,7 @@ D64File::writeByteToSector(uint8_t byte, Track *t, Sector *s)
     Sector sector = *s;
  
     assert(isValidTrackSectorPair(track, sector));
+    invalidateDirectoryIndex();
 
     int pos = offset(track, sector);
     uint8_t positionOfLastDataByte = data[pos + 1];
@@ -879,6 +893,12 @@ D64File::scanDirectory(long *offsets, unsigned *noOfFiles, bool skipInvisibleFil
 long
 D64File::findDirectoryEntry(long item, bool skipInvisibleFiles)
 {
+    // Visible files are looked up in the directory index
+    if (skipInvisibleFiles) {
+        DirectoryItem *entry = indexedItem(item);
+        return entry ? entry->entry : -1;
+    }
+    
     long offsets[144];
     unsigned noOfFiles;
     
@@ -902,6 +922,7 @@ D64File::writeDirectoryEntry(unsigned nr, const char *name,
         warn("Cannot write directory entry. Number of files is limited to 144\n");
         return false;
     }
+    invalidateDirectoryIndex();
 
     // Determine sector and relative sector position for this entry
     uint8_t sector = secnr[1 + (nr / 8)];
@@ -58,6 +58,51 @@ private:
      */
     long selectedItem = -1;
     
+    //! @brief    Information about a single directory item
+    typedef struct {
+        
+        //! @brief    Offset of the directory entry (points to the file type)
+        long entry;
+        
+        //! @brief    Offset of the first data byte (-1 if the file has none)
+        long start;
+        
+        //! @brief    File type character
+        uint8_t typeChar;
+        
+        //! @brief    File name (zero terminated)
+        char name[17];
+        
+        //! @brief    Location of the first data sector
+        Track firstTrack;
+        Sector firstSector;
+        
+        //! @brief    File size in blocks as stated in the directory
+        uint16_t sizeInBlocks;
+        
+        //! @brief    File size in bytes (without the load address)
+        size_t sizeInBytes;
+        
+        //! @brief    Number of sectors in the sector chain of this file
+        unsigned chainLength;
+        
+        //! @brief    Load address
+        uint16_t loadAddr;
+        
+    } DirectoryItem;
+    
+    /*! @brief    Directory index
+     *  @details  The index is built on the first access to an item and holds
+     *            all visible directory items. It saves us from walking the
+     *            directory and the sector chains over and over again.
+     */
+    DirectoryItem directory[144];
+    
+    /*! @brief    Number of items in the directory index
+     *  @details  -1, if the index needs to be rebuilt
+     */
+    int numIndexedItems = -1;
+    
 public:
 
     //
@@ -154,6 +199,19 @@ private:
      */
     long findItem(long item);
 
+    //! @brief    Builds the directory index
+    void buildDirectoryIndex();
+    
+    /*! @brief    Discards the directory index
+     *  @details  This function is called whenever the archive is modified.
+     */
+    void invalidateDirectoryIndex() { numIndexedItems = -1; }
+    
+    /*! @brief    Returns the directory index entry of an item
+     *  @return   NULL, if the item does not exist.
+     */
+    DirectoryItem *indexedItem(long item);
+
     /*! @brief    Returns true iff item is a visible file
      *  @details  Whether a file is visible or not is determined by the type
      *            character, a special byte stored inside the directory. The
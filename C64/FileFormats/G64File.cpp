@@ -92,6 +92,9 @@ G64File::makeWithDisk(Disk *disk)
 {
     assert(disk != NULL);
     
+    // Make sure that all tracks have been encoded
+    disk->encodePendingHalftracks();
+    
     // Determine empty (half)tracks
     bool empty[85];
     for (Halftrack ht = 1; ht <= 84; ht++) {
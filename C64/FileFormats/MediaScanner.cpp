@@ -0,0 +1,460 @@
+/*!
+ * @file        MediaScanner.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "MediaScanner.h"
+#include "AnyDisk.h"
+#include "D64File.h"
+#include "G64File.h"
+#include "CRTFile.h"
+#include "TAPFile.h"
+#include <algorithm>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(sizeof(MediaIndex::Record) == 32, "Index records must be 32 bytes");
+
+void
+*scannerThread(void *thisScanner)
+{
+    assert(thisScanner != NULL);
+
+    MediaScanner *scanner = (MediaScanner *)thisScanner;
+    scanner->work();
+    pthread_exit(NULL);
+}
+
+MediaScanner::MediaScanner()
+{
+    setDescription("MediaScanner");
+}
+
+void
+MediaScanner::addFile(const char *path)
+{
+    assert(path != NULL);
+
+    MediaRecord record;
+    record.path = path;
+    record.type = UNKNOWN_FILE_FORMAT;
+    record.valid = false;
+    record.supported = false;
+    record.hash = 0;
+    record.size = 0;
+    record.cartridgeType = CRT_NORMAL;
+    records.push_back(record);
+}
+
+unsigned
+MediaScanner::addDirectory(const char *path, bool recursive)
+{
+    assert(path != NULL);
+
+    std::vector<std::string> entries;
+    unsigned count = 0;
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        warn("Cannot open directory %s\n", path);
+        return 0;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            entries.push_back(std::string(path) + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    // Add the files in a reproducible order
+    std::sort(entries.begin(), entries.end());
+
+    for (auto &entry : entries) {
+
+        struct stat st;
+        if (stat(entry.c_str(), &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (recursive) count += addDirectory(entry.c_str(), true);
+        } else if (S_ISREG(st.st_mode)) {
+            addFile(entry.c_str());
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void
+MediaScanner::scan(unsigned numThreads)
+{
+    if (numThreads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = cores > 0 ? (unsigned)cores : 1;
+    }
+    numThreads = (unsigned)MIN(numThreads, MAX(records.size(), 1));
+
+    debug(1, "Scanning %zu files with %d threads\n", records.size(), numThreads);
+
+    // Launch the workers. They pick the records one after another.
+    pthread_t *threads = new pthread_t[numThreads];
+    nextRecord = 0;
+    for (unsigned i = 0; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, scannerThread, (void *)this);
+    }
+    for (unsigned i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    delete[] threads;
+}
+
+void
+MediaScanner::work()
+{
+    size_t nr;
+
+    while ((nr = nextRecord.fetch_add(1)) < records.size()) {
+        examine(records[nr]);
+    }
+}
+
+void
+MediaScanner::examine(MediaRecord &record)
+{
+    const char *path = record.path.c_str();
+    AnyC64File *file = NULL;
+    struct stat st;
+
+    if (stat(path, &st) == 0) {
+        record.size = st.st_size;
+    }
+
+    // Determine the file type and parse the file
+    if (CRTFile::isCRTFile(path)) {
+
+        record.type = CRT_FILE;
+        file = CRTFile::makeWithFile(path);
+
+    } else if (TAPFile::isTAPFile(path)) {
+
+        record.type = TAP_FILE;
+        file = TAPFile::makeWithFile(path);
+
+    } else if (AnyDisk *disk = AnyDisk::makeWithFile(path)) {
+
+        record.type = disk->type();
+        file = disk;
+
+    } else if (AnyArchive *archive = AnyArchive::makeWithFile(path)) {
+
+        record.type = archive->type();
+        file = archive;
+    }
+
+    if (file == NULL)
+        return;
+
+    record.valid = true;
+    record.supported = true;
+    record.name = file->getName();
+    record.hash = contentHash(file);
+
+    if (record.type == CRT_FILE) {
+
+        // Check if we are able to emulate this cartridge
+        size_t size = file->sizeOnDisk();
+        uint8_t *buffer = new uint8_t[size];
+        file->writeToBuffer(buffer);
+        record.cartridgeType = CRTFile::typeOfCRTBuffer(buffer, size);
+        record.supported = CRTFile::isSupportedCRTBuffer(buffer, size);
+        delete[] buffer;
+
+    } else if (record.type != TAP_FILE) {
+
+        // G64 files store bit streams. Decode them to get the directory.
+        AnyArchive *archive = (AnyArchive *)file;
+        D64File *decoded = NULL;
+        if (record.type == G64_FILE) {
+            Disk *disk = new Disk();
+            disk->encodeArchive((G64File *)file);
+            archive = decoded = D64File::makeWithDisk(disk);
+            delete disk;
+        }
+
+        // Extract the directory listing
+        int numItems = archive ? archive->numberOfItems() : 0;
+        char line[64];
+
+        for (int i = 0; i < numItems; i++) {
+            archive->selectItem(i);
+            const char *name = archive->getNameOfItem();
+            snprintf(line, sizeof(line), "%-16s  %-5s  %zu",
+                     name ? name : "", archive->getTypeOfItemAsString(),
+                     archive->getSizeOfItemInBlocks());
+            record.directory.push_back(line);
+        }
+        delete decoded;
+    }
+
+    delete file;
+}
+
+uint64_t
+MediaScanner::contentHash(AnyC64File *file)
+{
+    assert(file != NULL);
+
+    std::vector<uint8_t> buffer;
+    size_t start = 0, size;
+
+    switch (file->type()) {
+
+        case T64_FILE:
+        case PRG_FILE:
+        case P00_FILE:
+        {
+            // Hash the load address and data of each item
+            AnyArchive *archive = (AnyArchive *)file;
+            int numItems = archive->numberOfItems();
+
+            for (int i = 0; i < numItems; i++) {
+                archive->selectItem(i);
+                uint16_t loadAddr = archive->getDestinationAddrOfItem();
+                buffer.push_back(LO_BYTE(loadAddr));
+                buffer.push_back(HI_BYTE(loadAddr));
+                archive->seekItem(0);
+                for (int byte; (byte = archive->readItem()) != EOF;) {
+                    buffer.push_back((uint8_t)byte);
+                }
+            }
+            return fnv_1a_64(buffer.data(), buffer.size());
+        }
+        default:
+            break;
+    }
+
+    buffer.resize(file->sizeOnDisk());
+    file->writeToBuffer(buffer.data());
+    size = buffer.size();
+
+    switch (file->type()) {
+
+        case D64_FILE:
+        {
+            // Skip the error bytes
+            switch (((D64File *)file)->numberOfTracks()) {
+                case 35: size = MIN(size, D64_683_SECTORS); break;
+                case 40: size = MIN(size, D64_768_SECTORS); break;
+                case 42: size = MIN(size, D64_802_SECTORS); break;
+            }
+            break;
+        }
+        case TAP_FILE:
+
+            // Skip the header
+            start = MIN(size, 0x14);
+            break;
+
+        default:
+            break;
+    }
+
+    return fnv_1a_64(buffer.data() + start, size - start);
+}
+
+bool
+MediaScanner::writeIndex(const char *path)
+{
+    assert(path != NULL);
+
+    std::vector<MediaIndex::Record> index;
+    std::string strings(1, '\0'); // Offset 0 refers to the empty string
+
+    auto addString = [&strings](const std::string &str) -> uint32_t {
+        if (str.empty()) return 0;
+        uint32_t offset = (uint32_t)strings.size();
+        strings.append(str);
+        strings.push_back('\0');
+        return offset;
+    };
+
+    for (auto &record : records) {
+
+        std::string directory;
+        for (auto &item : record.directory) {
+            if (!directory.empty()) directory.push_back('\n');
+            directory.append(item);
+        }
+
+        MediaIndex::Record entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.hash = record.hash;
+        entry.size = (uint32_t)record.size;
+        entry.path = addString(record.path);
+        entry.name = addString(record.name);
+        entry.directory = addString(directory);
+        entry.type = (uint8_t)record.type;
+        entry.flags =
+        (record.valid ? MediaIndex::VALID : 0) |
+        (record.supported ? MediaIndex::SUPPORTED : 0);
+        entry.cartridgeType = (uint16_t)record.cartridgeType;
+        entry.numItems = (uint16_t)record.directory.size();
+        index.push_back(entry);
+    }
+
+    // Sort by hash to enable binary searches. Duplicates stay in scan order.
+    std::stable_sort(index.begin(), index.end(),
+                     [](const MediaIndex::Record &a, const MediaIndex::Record &b) {
+                         return a.hash < b.hash; });
+
+    // Assemble the header
+    uint8_t header[32];
+    uint32_t numRecords = (uint32_t)index.size();
+    uint32_t stringTableOffset = 32 + 32 * numRecords;
+    uint32_t stringTableSize = (uint32_t)strings.size();
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, MediaIndex::magicBytes, sizeof(MediaIndex::magicBytes));
+    memcpy(header + 0x08, &numRecords, 4);
+    memcpy(header + 0x0C, &stringTableOffset, 4);
+    memcpy(header + 0x10, &stringTableSize, 4);
+
+    // Write the file
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        warn("Cannot create %s\n", path);
+        return false;
+    }
+    bool success =
+    fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+    fwrite(index.data(), sizeof(MediaIndex::Record), numRecords, file) == numRecords &&
+    fwrite(strings.data(), 1, stringTableSize, file) == stringTableSize;
+    fclose(file);
+
+    if (!success) {
+        warn("Failed to write %s\n", path);
+        return false;
+    }
+
+    debug(1, "Wrote %d records to %s\n", numRecords, path);
+    return true;
+}
+
+
+//
+// MediaIndex
+//
+
+const uint8_t MediaIndex::magicBytes[8] = { 'V', 'C', '6', '4', 'I', 'D', 'X', 1 };
+
+MediaIndex::MediaIndex()
+{
+    setDescription("MediaIndex");
+}
+
+MediaIndex::~MediaIndex()
+{
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+MediaIndex *
+MediaIndex::makeWithFile(const char *path)
+{
+    MediaIndex *index = new MediaIndex();
+
+    if (!index->readFromFile(path)) {
+        delete index;
+        return NULL;
+    }
+
+    return index;
+}
+
+bool
+MediaIndex::readFromFile(const char *path)
+{
+    assert(path != NULL);
+    assert(mapping == NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        warn("Cannot open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 32) {
+        warn("%s is not an index file\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        warn("Cannot map %s\n", path);
+        return false;
+    }
+    mapping = (uint8_t *)map;
+    mappingSize = st.st_size;
+
+    // Check the header
+    uint32_t stringTableOffset;
+    memcpy(&numRecords, mapping + 0x08, 4);
+    memcpy(&stringTableOffset, mapping + 0x0C, 4);
+    memcpy(&stringTableSize, mapping + 0x10, 4);
+
+    if (memcmp(mapping, magicBytes, sizeof(magicBytes)) != 0 ||
+        stringTableOffset != 32 + 32 * (uint64_t)numRecords ||
+        stringTableOffset + (uint64_t)stringTableSize > mappingSize ||
+        stringTableSize == 0 || mapping[stringTableOffset + stringTableSize - 1] != 0) {
+
+        warn("%s is not a valid index file\n", path);
+        munmap(mapping, mappingSize);
+        mapping = NULL;
+        mappingSize = 0;
+        numRecords = stringTableSize = 0;
+        return false;
+    }
+
+    records = (const Record *)(mapping + 32);
+    strings = (const char *)(mapping + stringTableOffset);
+
+    debug(2, "Mapped %d records from %s\n", numRecords, path);
+    return true;
+}
+
+long
+MediaIndex::lookup(uint64_t hash)
+{
+    // Find the first record with a hash greater or equal to the requested one
+    uint32_t lo = 0, hi = numRecords;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (records[mid].hash < hash) lo = mid + 1; else hi = mid;
+    }
+
+    return (lo < numRecords && records[lo].hash == hash) ? (long)lo : -1;
+}
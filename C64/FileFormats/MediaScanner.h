@@ -0,0 +1,247 @@
+/*!
+ * @header      MediaScanner.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _MEDIASCANNER_INC
+#define _MEDIASCANNER_INC
+
+#include "VC64Object.h"
+#include "File_types.h"
+#include "Cartridge_types.h"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+
+class AnyC64File;
+
+/*! @brief    Information about a single media file
+ */
+typedef struct {
+
+    //! @brief    Path of the file
+    std::string path;
+
+    //! @brief    File type (UNKNOWN_FILE_FORMAT if the file is not recognized)
+    C64FileType type;
+
+    //! @brief    Indicates that the file has been parsed successfully
+    bool valid;
+
+    /*! @brief    Indicates that the emulator can handle the file
+     *  @details  This is only false for cartridges of unsupported types.
+     */
+    bool supported;
+
+    //! @brief    Content hash (fnv_1a_64 over the normalized file contents)
+    uint64_t hash;
+
+    //! @brief    File size in bytes
+    size_t size;
+
+    //! @brief    Logical name of the file (e.g., the disk name)
+    std::string name;
+
+    //! @brief    Cartridge type (CRT files only)
+    CartridgeType cartridgeType;
+
+    /*! @brief    Directory listing
+     *  @details  One line per item in the format "NAME  TYPE  BLOCKS".
+     */
+    std::vector<std::string> directory;
+
+} MediaRecord;
+
+
+/*! @class    MediaScanner
+ *  @brief    Classifies a collection of media files
+ *  @details  The scanner opens each file with the factory methods of the
+ *            file format classes, computes a content hash, and extracts the
+ *            directory listing or cartridge type. Files are processed on a
+ *            pool of worker threads. The results can be written into a
+ *            compact binary index (see MediaIndex). The scanner doesn't need
+ *            a C64 instance.
+ */
+class MediaScanner : public VC64Object {
+
+    //! @brief    One record per added file
+    std::vector<MediaRecord> records;
+
+    //! @brief    Index of the next record to be processed by a worker
+    std::atomic<size_t> nextRecord { 0 };
+
+public:
+
+    //! @brief    Constructor
+    MediaScanner();
+
+
+    //
+    //! @functiongroup Collecting files
+    //
+
+    //! @brief    Adds a single file
+    void addFile(const char *path);
+
+    /*! @brief    Adds all regular files of a directory
+     *  @param    recursive Set to true to descend into subdirectories.
+     *  @return   Number of added files
+     */
+    unsigned addDirectory(const char *path, bool recursive = true);
+
+
+    //
+    //! @functiongroup Scanning
+    //
+
+    /*! @brief    Processes all added files
+     *  @param    numThreads Number of worker threads. If 0 is passed in, one
+     *            thread per processor core is launched.
+     */
+    void scan(unsigned numThreads = 0);
+
+    //! @brief    The worker thread function
+    void work();
+
+    //! @brief    Returns the number of records
+    size_t numberOfRecords() { return records.size(); }
+
+    //! @brief    Returns a record
+    const MediaRecord &getRecord(size_t nr) { return records[nr]; }
+
+    /*! @brief    Computes the content hash of a file
+     *  @details  The hash is computed over the normalized file contents.
+     *            Information that doesn't belong to the actual content is
+     *            left out (error bytes of D64 files, the TAP header). Single
+     *            programs are hashed by their load address and data, no
+     *            matter if they are stored in a PRG, P00, or T64 file.
+     */
+    static uint64_t contentHash(AnyC64File *file);
+
+
+    //
+    //! @functiongroup Exporting
+    //
+
+    /*! @brief    Writes all records into a binary index file
+     *  @return   false, if the file could not be written
+     */
+    bool writeIndex(const char *path);
+
+private:
+
+    //! @brief    Examines a single file
+    void examine(MediaRecord &record);
+};
+
+
+/*! @class    MediaIndex
+ *  @brief    Read-only access to an index file written by MediaScanner
+ *  @details  The index file is mapped into memory and searched in place.
+ *            File layout (all values in little endian byte order):
+ *
+ *            Header (32 bytes)
+ *              0x00: Magic bytes "VC64IDX" followed by the version number
+ *              0x08: Number of records
+ *              0x0C: Offset of the string table
+ *              0x10: Size of the string table
+ *
+ *            Records (32 bytes each, sorted by hash)
+ *              0x00: Content hash
+ *              0x08: File size
+ *              0x0C: Path, name, and directory listing (string table
+ *                    offsets, directory items are separated by '\n')
+ *              0x18: File type, flags, cartridge type, number of items
+ *
+ *            String table (zero terminated strings)
+ */
+class MediaIndex : public VC64Object {
+
+public:
+
+    //! @brief    A single record as stored in the index file
+    typedef struct {
+
+        uint64_t hash;
+        uint32_t size;
+        uint32_t path;
+        uint32_t name;
+        uint32_t directory;
+        uint8_t type;
+        uint8_t flags;
+        uint16_t cartridgeType;
+        uint16_t numItems;
+        uint16_t reserved;
+
+    } Record;
+
+    //! @brief    Record flags
+    static const uint8_t VALID = 0x01;
+    static const uint8_t SUPPORTED = 0x02;
+
+    //! @brief    Magic bytes of an index file
+    static const uint8_t magicBytes[8];
+
+private:
+
+    //! @brief    Memory mapping of the index file
+    uint8_t *mapping = NULL;
+    size_t mappingSize = 0;
+
+    //! @brief    Pointers into the mapping
+    const Record *records = NULL;
+    const char *strings = NULL;
+
+    //! @brief    Number of records and size of the string table
+    uint32_t numRecords = 0;
+    uint32_t stringTableSize = 0;
+
+public:
+
+    //! @brief    Constructor
+    MediaIndex();
+
+    //! @brief    Destructor
+    ~MediaIndex();
+
+    //! @brief    Factory method
+    static MediaIndex *makeWithFile(const char *path);
+
+    //! @brief    Maps an index file into memory
+    bool readFromFile(const char *path);
+
+    //! @brief    Returns the number of records
+    uint32_t numberOfRecords() { return numRecords; }
+
+    //! @brief    Returns a record
+    const Record *getRecord(uint32_t nr) { return nr < numRecords ? &records[nr] : NULL; }
+
+    /*! @brief    Looks up a content hash
+     *  @details  Performs a binary search. Records with the same hash
+     *            (duplicates) are stored consecutively.
+     *  @return   Number of the first record with the specified hash or -1 if
+     *            the hash is not contained in the index.
+     */
+    long lookup(uint64_t hash);
+
+    //! @brief    Resolves a string table offset
+    const char *string(uint32_t offset) { return offset < stringTableSize ? strings + offset : ""; }
+};
+
+#endif
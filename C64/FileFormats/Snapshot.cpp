@@ -19,6 +19,7 @@
  */
 
 #include "C64.h"
+#include <algorithm>
 
 const uint8_t Snapshot::magicBytes[] = { 'V', 'C', '6', '4' };
 
@@ -106,6 +107,7 @@ Snapshot::Snapshot(size_t capacity)
     header->minor = V_MINOR;
     header->subminor = V_SUBMINOR;
     header->timestamp = time(NULL);
+    header->romSectionSize = 0;
 }
 
 Snapshot *
@@ -144,6 +146,14 @@ Snapshot::makeWithC64(C64 *c64)
     uint8_t *ptr = snapshot->getData();
     c64->saveToBuffer(&ptr);
     
+    // Keep the cartridge Roms alive (the state only contains their hashes)
+    std::vector<RomReference> &roms = snapshot->roms;
+    c64->expansionport.collectRoms(roms);
+    std::sort(roms.begin(), roms.end(), [](const RomReference &a, const RomReference &b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.size < b.size); });
+    roms.erase(std::unique(roms.begin(), roms.end(), [](const RomReference &a, const RomReference &b) {
+        return a.hash == b.hash && a.size == b.size; }), roms.end());
+    
     return snapshot;
 }
 
@@ -153,6 +163,73 @@ Snapshot::hasSameType(const char *filename)
     return Snapshot::isSnapshotFile(filename, V_MAJOR, V_MINOR, V_SUBMINOR);
 }
 
+bool
+Snapshot::readFromBuffer(const uint8_t *buffer, size_t length)
+{
+    roms.clear();
+    
+    if (!AnyC64File::readFromBuffer(buffer, length))
+        return false;
+    
+    if (size < sizeof(SnapshotHeader) ||
+        getHeader()->romSectionSize > size - sizeof(SnapshotHeader)) {
+        warn("Snapshot is corrupted\n");
+        return false;
+    }
+    
+    // Register the appended Rom data and strip it off
+    uint8_t *ptr = data + size - getHeader()->romSectionSize;
+    uint8_t *end = data + size;
+    size -= getHeader()->romSectionSize;
+    getHeader()->romSectionSize = 0;
+    
+    while (end - ptr >= 12) {
+        
+        uint64_t hash = read64(&ptr);
+        uint32_t romSize = read32(&ptr);
+        if (romSize > (size_t)(end - ptr)) {
+            warn("Snapshot contains truncated Rom data\n");
+            return false;
+        }
+        
+        std::shared_ptr<uint8_t> rom(new uint8_t[romSize], std::default_delete<uint8_t[]>());
+        readBlock(&ptr, rom.get(), romSize);
+        RomReference ref = RomStore::add(rom, romSize);
+        if (ref.hash != hash) {
+            warn("Rom data with hash %llX is corrupted\n", hash);
+        }
+        roms.push_back(ref);
+    }
+    
+    return true;
+}
+
+size_t
+Snapshot::writeToBuffer(uint8_t *buffer)
+{
+    assert(data != NULL);
+    
+    size_t romSectionSize = 0;
+    for (auto &rom : roms) {
+        romSectionSize += 12 + rom.size;
+    }
+    
+    if (buffer) {
+        
+        memcpy(buffer, data, size);
+        ((SnapshotHeader *)buffer)->romSectionSize = (uint32_t)romSectionSize;
+        
+        uint8_t *ptr = buffer + size;
+        for (auto &rom : roms) {
+            write64(&ptr, rom.hash);
+            write32(&ptr, rom.size);
+            writeBlock(&ptr, rom.data.get(), rom.size);
+        }
+    }
+    
+    return size + romSectionSize;
+}
+
 void
 Snapshot::takeScreenshot(C64 *c64)
 {
@@ -23,6 +23,7 @@
 #define _SNAPSHOT_INC
 
 #include "AnyC64File.h"
+#include "CartridgeRom.h"
 
 // Forward declarations
 class C64;
@@ -52,6 +53,14 @@ typedef struct {
     //! @brief    Date and time of snapshot creation
     time_t timestamp;
     
+    /*! @brief    Size of the appended Rom data in bytes
+     *  @details  The emulator state refers to cartridge Roms by hash. When a
+     *            snapshot is written to a file, the referenced Rom data is
+     *            appended to the emulator state. Each chunk is stored as a
+     *            64-bit hash, a 32-bit size, and the data.
+     */
+    uint32_t romSectionSize;
+    
 } SnapshotHeader;
 
 
@@ -66,6 +75,12 @@ class Snapshot : public AnyC64File {
     //! @brief    Header signature
     static const uint8_t magicBytes[];
     
+    /*! @brief    The Rom data referenced by the emulator state
+     *  @details  Holding these references keeps the data in the RomStore, so
+     *            the snapshot can be restored after the cartridge is gone.
+     */
+    std::vector<RomReference> roms;
+    
     
     //
     //! @functiongroup Class methods
@@ -129,6 +144,8 @@ class Snapshot : public AnyC64File {
     C64FileType type() { return V64_FILE; }
     const char *typeAsString() { return "V64"; }
     bool hasSameType(const char *filename);
+    bool readFromBuffer(const uint8_t *buffer, size_t length);
+    size_t writeToBuffer(uint8_t *buffer);
     
     
     //
@@ -0,0 +1,199 @@
+/*!
+ * @file        FingerprintTrace.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "FingerprintTrace.h"
+
+// File header (magic bytes)
+static const char traceMagic[8] = { 'V', 'C', '6', '4', 'F', 'P', 'T', 0x01 };
+
+// Number of bytes occupied by a single record on disk
+static const size_t recordSize = (FP_COUNT + 3) * sizeof(uint64_t);
+
+FingerprintTrace::FingerprintTrace()
+{
+    setDescription("FingerprintTrace");
+}
+
+const char *
+FingerprintTrace::componentName(FingerprintComponent nr)
+{
+    switch (nr) {
+        case FP_CPU:    return "CPU";
+        case FP_CIA1:   return "CIA1";
+        case FP_CIA2:   return "CIA2";
+        case FP_VIC:    return "VIC";
+        case FP_SID:    return "SID";
+        case FP_MEMORY: return "Memory";
+        case FP_DRIVE1: return "Drive1";
+        case FP_DRIVE2: return "Drive2";
+        default:        return "???";
+    }
+}
+
+bool
+FingerprintTrace::writeToFile(const char *filename)
+{
+    assert(filename != NULL);
+
+    FILE *file;
+    size_t size = sizeof(traceMagic) + sizeof(uint64_t) + records.size() * recordSize;
+    uint8_t *buffer = new uint8_t[size];
+    uint8_t *ptr = buffer;
+
+    // Serialize records
+    memcpy(ptr, traceMagic, sizeof(traceMagic));
+    ptr += sizeof(traceMagic);
+    write64(&ptr, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        write64(&ptr, records[i].frame);
+        write64(&ptr, records[i].cycle);
+        for (unsigned j = 0; j < FP_COUNT; j++)
+            write64(&ptr, records[i].component[j]);
+        write64(&ptr, records[i].hash);
+    }
+    assert((size_t)(ptr - buffer) == size);
+
+    // Write to file
+    bool success = false;
+    if ((file = fopen(filename, "w"))) {
+        success = fwrite(buffer, 1, size, file) == size;
+        fclose(file);
+    }
+
+    delete[] buffer;
+    return success;
+}
+
+bool
+FingerprintTrace::readFromFile(const char *filename)
+{
+    assert(filename != NULL);
+
+    bool success = false;
+    uint8_t *buffer = NULL;
+    uint8_t *ptr;
+    uint64_t numRecords;
+    FILE *file;
+    struct stat fileProperties;
+
+    if (stat(filename, &fileProperties) != 0) {
+        return false;
+    }
+    if (!(file = fopen(filename, "r"))) {
+        return false;
+    }
+
+    size_t size = (size_t)fileProperties.st_size;
+    buffer = new uint8_t[size];
+    if (fread(buffer, 1, size, file) != size) {
+        goto exit;
+    }
+
+    // Check header
+    if (size < sizeof(traceMagic) + sizeof(uint64_t) ||
+        memcmp(buffer, traceMagic, sizeof(traceMagic)) != 0) {
+        warn("%s is not a fingerprint trace.\n", filename);
+        goto exit;
+    }
+    ptr = buffer + sizeof(traceMagic);
+    numRecords = read64(&ptr);
+    if (size != sizeof(traceMagic) + sizeof(uint64_t) + numRecords * recordSize) {
+        warn("%s is corrupted.\n", filename);
+        goto exit;
+    }
+
+    // Deserialize records
+    records.clear();
+    records.reserve(numRecords);
+    for (uint64_t i = 0; i < numRecords; i++) {
+        StateFingerprint fp;
+        fp.frame = read64(&ptr);
+        fp.cycle = read64(&ptr);
+        for (unsigned j = 0; j < FP_COUNT; j++)
+            fp.component[j] = read64(&ptr);
+        fp.hash = read64(&ptr);
+        records.push_back(fp);
+    }
+    success = true;
+
+exit:
+
+    fclose(file);
+    delete[] buffer;
+    return success;
+}
+
+bool
+FingerprintTrace::findDivergence(FingerprintTrace *other, DivergenceInfo *info)
+{
+    assert(other != NULL);
+    assert(info != NULL);
+
+    size_t count = MIN(records.size(), other->records.size());
+
+    memset(info, 0, sizeof(DivergenceInfo));
+    info->index = -1;
+
+    for (size_t i = 0; i < count; i++) {
+
+        StateFingerprint &fp1 = records[i];
+        StateFingerprint &fp2 = other->records[i];
+
+        if (fp1.cycle != fp2.cycle) {
+            warn("Traces have been recorded with different intervals.\n");
+            return false;
+        }
+
+        if (fp1.hash != fp2.hash) {
+
+            info->diverged = true;
+            info->index = (long)i;
+            info->frame = fp1.frame;
+            info->cycle = fp1.cycle;
+            info->lastMatchingCycle = i ? records[i - 1].cycle : 0;
+            for (unsigned j = 0; j < FP_COUNT; j++) {
+                if (fp1.component[j] != fp2.component[j])
+                    info->components |= 1 << j;
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+FingerprintTrace::dump(DivergenceInfo info)
+{
+    if (!info.diverged) {
+        msg("No divergence found in %d records.\n", records.size());
+        return;
+    }
+
+    msg("First divergence in record %ld (frame %lld)\n", info.index, info.frame);
+    msg("Cycle range: %lld ... %lld\n", info.lastMatchingCycle + 1, info.cycle);
+    msg("Components: ");
+    for (unsigned j = 0; j < FP_COUNT; j++) {
+        if (info.components & (1 << j))
+            msg("%s ", componentName((FingerprintComponent)j));
+    }
+    msg("\n");
+}
@@ -0,0 +1,87 @@
+/*!
+ * @header      FingerprintTrace.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _FINGERPRINT_TRACE_INC
+#define _FINGERPRINT_TRACE_INC
+
+#include "VC64Object.h"
+#include <vector>
+
+using namespace std;
+
+/*! @brief    A sequence of state fingerprints
+ *  @details  A trace is recorded by the C64 while running a workload. Traces
+ *            recorded by two different builds or configurations can be saved
+ *            to disk and compared afterwards to locate the first point in time
+ *            where the machine states diverge. To narrow down the divergence,
+ *            the workload is replayed with a smaller recording interval.
+ *  @see      C64::setFingerprintInterval()
+ */
+class FingerprintTrace : public VC64Object {
+
+    private:
+
+    //! @brief    The recorded fingerprints
+    vector<StateFingerprint> records;
+
+    public:
+
+    //! @brief    Constructor
+    FingerprintTrace();
+
+    //! @brief    Returns a textual description for a fingerprint component.
+    static const char *componentName(FingerprintComponent nr);
+
+    //! @brief    Deletes all records.
+    void clear() { records.clear(); }
+
+    //! @brief    Appends a record.
+    void record(StateFingerprint fp) { records.push_back(fp); }
+
+    //! @brief    Returns the number of records.
+    size_t count() { return records.size(); }
+
+    //! @brief    Returns a certain record.
+    StateFingerprint getRecord(size_t nr) { return records.at(nr); }
+
+    /*! @brief    Writes the trace to a file.
+     *  @details  All values are stored in big endian format. Hence, traces can
+     *            be exchanged between different machines.
+     */
+    bool writeToFile(const char *filename);
+
+    //! @brief    Replaces the trace by the contents of a file.
+    bool readFromFile(const char *filename);
+
+    /*! @brief    Compares this trace with another one.
+     *  @details  Both traces must have been recorded with the same interval.
+     *            The function reports the first record with a mismatching
+     *            fingerprint together with a bit mask of all mismatching
+     *            components (1 << FingerprintComponent).
+     *  @return   true if a divergence has been found.
+     */
+    bool findDivergence(FingerprintTrace *other, DivergenceInfo *info);
+
+    //! @brief    Prints the result of findDivergence() in human readable form.
+    void dump(DivergenceInfo info);
+};
+
+#endif
@@ -249,3 +249,72 @@ VirtualComponent::saveToBuffer(uint8_t **buffer)
         assert(false);
     }
 }
+
+uint64_t
+VirtualComponent::fingerprint()
+{
+    uint64_t result = fnv_1a_init64();
+    
+    // Hash sub components
+    if (subComponents != NULL) {
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            result = fnv_1a_it64(result, subComponents[i]->fingerprint());
+    }
+    
+    // Hash own snapshot items
+    void *data; size_t size; int flags;
+    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++) {
+        
+        data  = snapshotItems[i].data;
+        flags = snapshotItems[i].flags & 0x0F;
+        size  = snapshotItems[i].size;
+        
+        if (flags == 0) { // Auto detect size
+            
+            switch (size) {
+                case 1:  result = fnv_1a_it64(result, *(uint8_t *)data); break;
+                case 2:  result = fnv_1a_it64(result, *(uint16_t *)data); break;
+                case 4:  result = fnv_1a_it64(result, *(uint32_t *)data); break;
+                case 8:  result = fnv_1a_it64(result, *(uint64_t *)data); break;
+                default: result = fnv_1a_it64(result, fnv_1a_64((uint8_t *)data, size));
+            }
+            
+        } else { // Format is specified manually
+            
+            switch (flags) {
+                case BYTE_ARRAY:
+                    result = fnv_1a_it64(result, fnv_1a_64((uint8_t *)data, size));
+                    break;
+                case WORD_ARRAY:
+                    for (size_t j = 0; j < size / 2; j++)
+                        result = fnv_1a_it64(result, ((uint16_t *)data)[j]);
+                    break;
+                case DWORD_ARRAY:
+                    for (size_t j = 0; j < size / 4; j++)
+                        result = fnv_1a_it64(result, ((uint32_t *)data)[j]);
+                    break;
+                case QWORD_ARRAY:
+                    for (size_t j = 0; j < size / 8; j++)
+                        result = fnv_1a_it64(result, ((uint64_t *)data)[j]);
+                    break;
+                default: assert(0);
+            }
+        }
+    }
+    
+    return result;
+}
+
+uint64_t
+VirtualComponent::snapshotFingerprint()
+{
+    size_t size = stateSize();
+    uint8_t *buffer = new uint8_t[size];
+    uint8_t *ptr = buffer;
+    
+    saveToBuffer(&ptr);
+    uint64_t result = fnv_1a_64(buffer, size);
+    
+    delete[] buffer;
+    return result;
+}
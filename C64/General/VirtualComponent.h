@@ -223,6 +223,30 @@ public:
      */
     virtual void  willSaveToBuffer(uint8_t **buffer) { };
     virtual void  didSaveToBuffer(uint8_t **buffer) { };
+    
+    
+    //
+    //! @functiongroup Fingerprinting the component state
+    //
+    
+    /*! @brief    Returns a hash value of the internal state.
+     *  @details  The default implementation hashes the snapshot items of the
+     *            component and its sub components in place. Nothing is
+     *            allocated or serialized and the snapshot delegation methods
+     *            are not invoked. Multi-byte values are hashed by value, so
+     *            the result doesn't depend on the host's byte order.
+     *            Components with large or non-deterministic state overwrite
+     *            this method to hash the relevant parts, only.
+     *  @see      C64::getFingerprint()
+     */
+    virtual uint64_t fingerprint();
+    
+    /*! @brief    Returns a hash value of the complete snapshot data.
+     *  @details  The component is serialized into a temporary buffer which
+     *            is hashed afterwards. This is much slower than fingerprint()
+     *            and intended for debugging, only.
+     */
+    uint64_t snapshotFingerprint();
 };
 
 #endif
@@ -28,6 +28,7 @@ C64Memory::C64Memory()
 		
     memset(rom, 0, sizeof(rom));
     stack = &ram[0x0100];
+    markRamAsDirty();
     
     // Register snapshot items
     SnapshotItem items[] = {
@@ -185,6 +186,24 @@ C64Memory::eraseWithPattern(RamInitPattern pattern)
     
     // Make the screen look nice on startup
     memset(&ram[0x400], 0x01, 40*25);
+    
+    markRamAsDirty();
+}
+
+uint64_t
+C64Memory::fingerprint()
+{
+    uint64_t result = fnv_1a_init64();
+    
+    for (unsigned page = 0; page < 256; page++) {
+        if (ramPageDirty[page]) {
+            ramPageHash[page] = fnv_1a_64(ram + (page << 8), 256);
+            ramPageDirty[page] = false;
+        }
+        result = fnv_1a_it64(result, ramPageHash[page]);
+    }
+    
+    return fnv_1a_it64(result, fnv_1a_64(colorRam, sizeof(colorRam)));
 }
 
 void 
@@ -404,7 +423,7 @@ C64Memory::poke(uint16_t addr, uint8_t value, MemoryType target)
             
         case M_RAM:
         case M_ROM:
-            ram[addr] = value;
+            pokeRam(addr, value);
             return;
             
         case M_IO:
@@ -418,7 +437,7 @@ C64Memory::poke(uint16_t addr, uint8_t value, MemoryType target)
             
         case M_PP:
             if (likely(addr >= 0x02)) {
-                ram[addr] = value;
+                pokeRam(addr, value);
             } else if (addr == 0x00) {
                 c64->processorPort.writeDirection(value);
             } else {
@@ -449,7 +468,7 @@ void
 C64Memory::pokeZP(uint8_t addr, uint8_t value)
 {
     if (likely(addr >= 0x02)) {
-        ram[addr] = value;
+        pokeRam(addr, value);
     } else if (addr == 0x00) {
         c64->processorPort.writeDirection(value);
     } else {
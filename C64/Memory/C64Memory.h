@@ -108,6 +108,17 @@ public:
     //! @brief    Poke target lookup table
     MemoryType pokeTarget[16];
     
+    /*! @brief    Dirty flags of the 256 RAM pages
+     *  @details  A flag is set whenever a cell of the corresponding page is
+     *            written. The flags are used to update the RAM fingerprint
+     *            incrementally.
+     *  @see      fingerprint()
+     */
+    bool ramPageDirty[256];
+    
+    //! @brief    Cached fingerprints of the 256 RAM pages
+    uint64_t ramPageHash[256];
+    
 public:
     
 	//! @brief    Constructor
@@ -124,6 +135,16 @@ public:
 
 	//! @brief    Method from VirtualComponent
 	void dump();
+    
+    //! @brief    Method from VirtualComponent
+    void didLoadFromBuffer(uint8_t **buffer) { markRamAsDirty(); }
+    
+    /*! @brief    Method from VirtualComponent
+     *  @details  The fingerprint covers RAM and color RAM. RAM is hashed
+     *            page-wise and only the pages that have been written to since
+     *            the last call are rehashed.
+     */
+    uint64_t fingerprint();
 
 	//! @brief    Returns true, iff the Basic ROM has been loaded
 	bool basicRomIsLoaded() { return (rom[0xA000] | rom[0xA001]) != 0x00; }
@@ -202,6 +223,16 @@ public:
     void poke(uint16_t addr, uint8_t value) { poke(addr, value, pokeTarget[addr >> 12]); }
     void pokeZP(uint8_t addr, uint8_t value);
     void pokeIO(uint16_t addr, uint8_t value);
+    void pokeStack(uint8_t sp, uint8_t value) { pokeRam(0x100 + sp, value); }
+    
+    //! @brief    Writes into RAM, regardless of the current memory mapping.
+    void pokeRam(uint16_t addr, uint8_t value) {
+        ram[addr] = value; ramPageDirty[addr >> 8] = true; }
+    
+    /*! @brief    Marks all RAM pages as modified
+     *  @details  Call this function after writing into the ram array directly.
+     */
+    void markRamAsDirty() { memset(ramPageDirty, true, sizeof(ramPageDirty)); }
     
     //! @brief    Reads the NMI vector from memory.
     uint16_t nmiVector();
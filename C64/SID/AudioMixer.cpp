@@ -0,0 +1,212 @@
+/*!
+ * @file        AudioMixer.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "C64.h"
+
+AudioMixer::AudioMixer(uint32_t sampleRate)
+{
+    setDescription("AudioMixer");
+    
+    this->sampleRate = sampleRate;
+    for (unsigned i = 0; i < maxSources; i++) {
+        sources[i].sid = NULL;
+        sources[i].gain = 1.0f;
+    }
+}
+
+int
+AudioMixer::lookup(SIDBridge *sid)
+{
+    for (unsigned i = 0; i < maxSources; i++) {
+        if (sources[i].sid == sid) return i;
+    }
+    return -1;
+}
+
+bool
+AudioMixer::addSource(SIDBridge *sid, float gain)
+{
+    assert(sid != NULL);
+    
+    if (lookup(sid) >= 0) {
+        warn("Audio source %p is already registered\n", sid);
+        return false;
+    }
+    
+    int slot = lookup(NULL);
+    if (slot < 0) {
+        warn("Cannot register more than %d audio sources\n", maxSources);
+        return false;
+    }
+    
+    // Initialize the slot before the audio thread can see it
+    Source &source = sources[slot];
+    source.gain = gain;
+    source.phase = 0.0;
+    source.history[0] = 0.0f;
+    source.history[1] = 0.0f;
+    source.sid = sid;
+    
+    debug(2, "Added audio source %p in slot %d\n", sid, slot);
+    return true;
+}
+
+void
+AudioMixer::removeSource(SIDBridge *sid)
+{
+    int slot = lookup(sid);
+    if (slot < 0)
+        return;
+    
+    sources[slot].sid = NULL;
+    
+    // Wait until the audio thread has stopped using the source
+    while (mixing) {
+        sched_yield();
+    }
+    
+    debug(2, "Removed audio source %p from slot %d\n", sid, slot);
+}
+
+unsigned
+AudioMixer::numSources()
+{
+    unsigned result = 0;
+    for (unsigned i = 0; i < maxSources; i++) {
+        if (sources[i].sid != NULL) result++;
+    }
+    return result;
+}
+
+float
+AudioMixer::getGain(SIDBridge *sid)
+{
+    int slot = lookup(sid);
+    return slot >= 0 ? (float)sources[slot].gain : 0.0f;
+}
+
+void
+AudioMixer::setGain(SIDBridge *sid, float gain)
+{
+    int slot = lookup(sid);
+    if (slot >= 0) sources[slot].gain = gain;
+}
+
+void
+AudioMixer::readMonoSamples(float *target, size_t n)
+{
+    while (n) {
+        size_t chunk = MIN(n, chunkSize);
+        mix(target, chunk);
+        target += chunk;
+        n -= chunk;
+    }
+}
+
+void
+AudioMixer::readStereoSamples(float *target1, float *target2, size_t n)
+{
+    readMonoSamples(target1, n);
+    memcpy(target2, target1, n * sizeof(float));
+}
+
+void
+AudioMixer::readStereoSamplesInterleaved(float *target, size_t n)
+{
+    // Mix into the upper half and spread the samples out in place
+    readMonoSamples(target + n, n);
+    for (size_t i = 0; i < n; i++) {
+        float value = target[n + i];
+        target[i*2] = value;
+        target[i*2+1] = value;
+    }
+}
+
+void
+AudioMixer::mix(float *target, size_t n)
+{
+    assert(n <= chunkSize);
+    
+    memset(target, 0, n * sizeof(float));
+    
+    mixing = true;
+    for (unsigned i = 0; i < maxSources; i++) {
+        
+        SIDBridge *sid = sources[i].sid;
+        if (sid == NULL) continue;
+        
+        pull(sources[i], sid, n);
+        
+        // Add the samples to the output (the compiler vectorizes this loop)
+        float gain = sources[i].gain;
+        for (size_t j = 0; j < n; j++) {
+            target[j] += gain * resampled[j];
+        }
+    }
+    mixing = false;
+}
+
+void
+AudioMixer::pull(Source &source, SIDBridge *sid, size_t n)
+{
+    uint32_t inRate = sid->getSampleRate();
+    uint32_t outRate = sampleRate;
+    
+    // Read the samples directly if no conversion is needed
+    if (inRate == outRate || inRate == 0 || outRate == 0) {
+        sid->readMonoSamples(resampled, n);
+        source.history[0] = n > 1 ? resampled[n - 2] : source.history[1];
+        source.history[1] = resampled[n - 1];
+        source.phase = 0.0;
+        return;
+    }
+    
+    double step = (double)inRate / (double)outRate;
+    size_t maxChunk = MAX((size_t)1, (size_t)((4 * chunkSize - 1) / step));
+    float *out = resampled;
+    
+    while (n) {
+        
+        size_t m = MIN(n, maxChunk);
+        double phase = source.phase;
+        
+        // Read all samples up to the last interpolation position
+        long needed = (long)floor(phase + (m - 1) * step) + 1;
+        assert(needed >= 0 && needed <= (long)(4 * chunkSize));
+        input[0] = source.history[0];
+        input[1] = source.history[1];
+        if (needed) sid->readMonoSamples(input + 2, needed);
+        
+        // Interpolate linearly (input[1] is located at position 0)
+        for (size_t k = 0; k < m; k++) {
+            double pos = phase + k * step + 1.0;
+            size_t j = (size_t)pos;
+            float f = (float)(pos - j);
+            out[k] = input[j] + f * (input[j + 1] - input[j]);
+        }
+        
+        source.history[0] = input[needed];
+        source.history[1] = input[needed + 1];
+        source.phase = phase + m * step - needed;
+        out += m;
+        n -= m;
+    }
+}
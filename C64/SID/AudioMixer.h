@@ -0,0 +1,154 @@
+/*!
+ * @header      AudioMixer.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _AUDIOMIXER_INC
+#define _AUDIOMIXER_INC
+
+#include "VC64Object.h"
+#include <atomic>
+
+class SIDBridge;
+
+/*! @brief    Mixes the audio streams of multiple emulator instances
+ *  @details  The mixer owns the output stream of the host. Each time the
+ *            audio callback asks for samples, the mixer pulls a block from
+ *            the ringbuffer of each registered SIDBridge, converts it to
+ *            the output sample rate, scales it by the gain of the source,
+ *            and adds it to the output.
+ *            The mixer only acts as the consumer of the ringbuffers. Hence,
+ *            the emulator threads are not affected at all. Sources are
+ *            added and removed by the host without blocking the audio
+ *            callback.
+ */
+class AudioMixer : public VC64Object {
+    
+public:
+    
+    //! @brief    Maximum number of sources
+    static constexpr unsigned maxSources = 8;
+    
+private:
+    
+    //! @brief    A registered audio source
+    typedef struct {
+        
+        //! @brief    The ringbuffer owner (NULL if the slot is free)
+        std::atomic<SIDBridge *> sid;
+        
+        //! @brief    Scaling factor applied to the samples of this source
+        std::atomic<float> gain;
+        
+        /*! @brief    Read position of the resampler
+         *  @details  The position is relative to the most recent sample read
+         *            from the ringbuffer. It is always greater than -1.
+         */
+        double phase;
+        
+        //! @brief    The two most recent samples read from the ringbuffer
+        float history[2];
+        
+    } Source;
+    
+    //! @brief    The audio sources
+    Source sources[maxSources];
+    
+    //! @brief    Sample rate of the output stream
+    std::atomic<uint32_t> sampleRate;
+    
+    /*! @brief    Indicates that the audio callback is running
+     *  @details  removeSource() waits for this flag to be cleared before it
+     *            returns. Afterwards, the removed source is no longer
+     *            accessed by the mixer.
+     */
+    std::atomic<bool> mixing { false };
+    
+    //! @brief    Maximum number of samples processed in one go
+    static constexpr size_t chunkSize = 1024;
+    
+    //! @brief    Samples read from a source (plus two history samples)
+    float input[4 * chunkSize + 2];
+    
+    //! @brief    Samples of a source at the output sample rate
+    float resampled[chunkSize];
+    
+public:
+    
+    //! @brief    Constructor
+    AudioMixer(uint32_t sampleRate = 44100);
+    
+    //! @brief    Returns the sample rate of the output stream.
+    uint32_t getSampleRate() { return sampleRate; }
+    
+    /*! @brief    Sets the sample rate of the output stream.
+     *  @details  The sources are resampled to this rate if they run at a
+     *            different rate. For best quality, the sample rate of each
+     *            source should match the output rate.
+     */
+    void setSampleRate(uint32_t rate) { sampleRate = rate; }
+    
+    /*! @brief    Registers an audio source.
+     *  @return   false, if the source is already registered or if all
+     *            slots are in use.
+     */
+    bool addSource(SIDBridge *sid, float gain = 1.0f);
+    
+    /*! @brief    Unregisters an audio source.
+     *  @details  When this function returns, the mixer won't access the
+     *            source anymore. It is safe to delete the emulator instance
+     *            afterwards.
+     */
+    void removeSource(SIDBridge *sid);
+    
+    //! @brief    Returns the number of registered sources.
+    unsigned numSources();
+    
+    //! @brief    Returns the gain of a registered source.
+    float getGain(SIDBridge *sid);
+    
+    //! @brief    Sets the gain of a registered source.
+    void setGain(SIDBridge *sid, float gain);
+    
+    //! @brief    Mixes a certain amount of samples into a mono stream.
+    void readMonoSamples(float *target, size_t n);
+    
+    //! @brief    Mixes a certain amount of samples into two mono streams.
+    void readStereoSamples(float *target1, float *target2, size_t n);
+    
+    //! @brief    Mixes a certain amount of samples into an interleaved stream.
+    void readStereoSamplesInterleaved(float *target, size_t n);
+    
+private:
+    
+    //! @brief    Returns the slot of a registered source or -1.
+    int lookup(SIDBridge *sid);
+    
+    //! @brief    Mixes a block of at most chunkSize samples.
+    void mix(float *target, size_t n);
+    
+    /*! @brief    Reads n samples at the output rate from a source
+     *  @details  The result is stored in the resampled buffer. If the source
+     *            runs at a different sample rate, the samples are linearly
+     *            interpolated.
+     */
+    void pull(Source &source, SIDBridge *sid, size_t n);
+};
+
+#endif
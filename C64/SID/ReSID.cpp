@@ -227,6 +227,19 @@ ReSID::poke(uint16_t addr, uint8_t value)
     sid->write(addr, value);
 }
 
+void
+ReSID::loadRegisters(const uint8_t *regs)
+{
+    reset();
+    
+    // Clock reSID after each write to let it pass the write pipeline
+    for (uint8_t addr = 0; addr <= 0x18; addr++) {
+        sid->write(addr, regs[addr]);
+        sid->clock_silent(1);
+    }
+    sid->settle_envelopes();
+}
+
 void
 ReSID::execute(uint64_t elapsedCycles)
 {
@@ -244,6 +257,12 @@ ReSID::execute(uint64_t elapsedCycles)
     // Let reSID compute some sound samples
     while (delta_t) {
         bufindex += sid->clock(delta_t, buf + bufindex, buflength - bufindex);
+        
+        // reSID stops clocking if the buffer is full
+        if (bufindex == buflength) {
+            bridge->writeData(buf, bufindex);
+            bufindex = 0;
+        }
     }
     
     // Write samples into ringbuffer
@@ -252,6 +271,20 @@ ReSID::execute(uint64_t elapsedCycles)
     }
 }
 
+void
+ReSID::executeSilently(uint64_t elapsedCycles)
+{
+    // reSID computes the oscillator increment as delta_t * freq with 32 bit
+    // integers. To avoid an overflow, we split up large cycle counts.
+    const uint64_t chunkSize = 0xFFFF;
+    
+    while (elapsedCycles > chunkSize) {
+        sid->clock_silent((reSID::cycle_count)chunkSize);
+        elapsedCycles -= chunkSize;
+    }
+    sid->clock_silent((reSID::cycle_count)elapsedCycles);
+}
+
 SIDInfo
 ReSID::getInfo()
 {
@@ -292,4 +325,69 @@ ReSID::getVoiceInfo(unsigned voice)
     return info;
 }
 
-
+bool
+ReSID::benchmarkResampler(uint64_t cycles)
+{
+    const char *kernelName[] = { "Scalar", "SSE2", "AVX2", "NEON" };
+    const reSID::sampling_method methods[] = {
+        reSID::SAMPLE_RESAMPLE, reSID::SAMPLE_RESAMPLE_FASTMEM };
+    const size_t maxSamples = (size_t)(cycles * sampleRate / clockFrequency) + 1;
+    bool identical = true;
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    
+    short *reference = new short[maxSamples];
+    short *samples = new short[maxSamples];
+    
+    for (unsigned m = 0; m < 2; m++) {
+        
+        msg("%s:\n", m ? "SAMPLE_RESAMPLE_FASTMEM" : "SAMPLE_RESAMPLE");
+        
+        for (unsigned k = reSID::CONVOLVE_SCALAR; k <= reSID::CONVOLVE_NEON; k++) {
+            
+            if (!reSID::SID::has_convolution_kernel((reSID::convolution_kernel)k))
+                continue;
+            
+            // Setup a reSID instance with the current configuration
+            reSID::SID *resid = new reSID::SID();
+            resid->set_chip_model((reSID::chip_model)model);
+            resid->set_sampling_parameters((double)clockFrequency, methods[m],
+                                           (double)sampleRate);
+            resid->enable_filter(emulateFilter);
+            resid->set_convolution_kernel((reSID::convolution_kernel)k);
+            
+            // Run reSID with the same random register writes each time
+            uint32_t seed = 42;
+            size_t count = 0;
+            uint64_t start = mach_absolute_time();
+            
+            for (uint64_t cycle = 0; cycle < cycles; cycle += 1000) {
+                
+                seed = seed * 1103515245 + 12345;
+                resid->write((seed >> 16) % 0x19, (uint8_t)(seed >> 8));
+                
+                reSID::cycle_count delta_t = (reSID::cycle_count)MIN(1000, cycles - cycle);
+                short *buf = (k == reSID::CONVOLVE_SCALAR) ? reference : samples;
+                while (delta_t && count < maxSamples) {
+                    count += resid->clock(delta_t, buf + count, (int)(maxSamples - count));
+                }
+            }
+            
+            uint64_t elapsed =
+            (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+            delete resid;
+            
+            // Compare with the scalar implementation
+            bool match = (k == reSID::CONVOLVE_SCALAR) ||
+            memcmp(reference, samples, count * sizeof(short)) == 0;
+            identical &= match;
+            
+            msg("    %6s: %6lld usec (%zu samples) %s\n",
+                kernelName[k], elapsed / 1000, count, match ? "" : "MISMATCH");
+        }
+    }
+    
+    delete[] reference;
+    delete[] samples;
+    return identical;
+}
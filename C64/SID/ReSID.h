@@ -21,6 +21,9 @@
 
 // List of modifications applied to reSID
 // 1. Changed visibility of some objects from protected to public
+// 2. Added SID::clock_silent() which skips the filter stage
+// 3. Added SIMD kernels for the FIR convolution of the resampling methods
+// 4. Added SID::settle_envelopes() for restoring a SID from its registers
 
 // Good candidate for testing sound emulation: INTERNAT.P00
 
@@ -90,12 +93,27 @@ public:
 	
 	//! Special poke function for the I/O memory range.
 	void poke(uint16_t addr, uint8_t value);
+    
+    /*! @brief   Reconstructs the SID state from the register contents
+     *  @details Resets reSID, replays the register writes and moves the
+     *           envelopes of all gated voices to their sustain level. This
+     *           function is called when reSID becomes the active sound
+     *           engine.
+     *  @param   regs The values of registers 0x00 to 0x18
+     */
+    void loadRegisters(const uint8_t *regs);
 	
 	/*! @brief   Execute SID
      *  @details Runs reSID for the specified amount of CPU cycles and writes
      *           the generated sound samples into the internal ring buffer. 
      */
     void execute(uint64_t cycles);
+    
+    /*! @brief   Execute SID without producing sound samples
+     *  @details Only advances the oscillators and envelope generators which
+     *           are needed to answer reads from the OSC3 and ENV3 registers.
+     */
+    void executeSilently(uint64_t cycles);
 	
 
     // Configuring
@@ -124,6 +142,13 @@ public:
     //! Sets the sample rate
     void setSampleRate(uint32_t rate);
     
+    /*! @brief   Changes the number of samples computed per second
+     *  @details Unlike setSampleRate(), this function doesn't recompute the
+     *           resampling filter. It is used by the dynamic rate control to
+     *           slightly speed up or slow down sample production.
+     */
+    void adjustSampleRate(double rate) { sid->adjust_sampling_frequency(rate); }
+    
     //! Returns true iff audio filters should be emulated.
     bool getAudioFilter() { return emulateFilter; }
     
@@ -138,6 +163,20 @@ public:
     
     //! Set sampling method
     void setSamplingMethod(SamplingMethod value);
+    
+    
+    // Debugging
+    
+    /*! @brief   Benchmarks the FIR convolution kernels
+     *  @details Runs reSID with both resampling methods on a random sequence
+     *           of register writes, once for each convolution kernel that is
+     *           supported by the host CPU. The execution times are printed
+     *           and the produced samples are compared with the ones of the
+     *           scalar kernel.
+     *  @param   cycles Number of CPU cycles to emulate per run
+     *  @return  true if all kernels produced identical samples
+     */
+    bool benchmarkResampler(uint64_t cycles = PAL_CYCLES_PER_SECOND);
 };
 
 #endif
@@ -39,16 +39,20 @@ SIDBridge::SIDBridge()
         { &useReSID,        sizeof(useReSID),       KEEP_ON_RESET },
 
         // Internal state
+        { sidreg,           sizeof(sidreg),         CLEAR_ON_RESET },
         { &cycles,          sizeof(cycles),         CLEAR_ON_RESET },
         { NULL,             0,                      0 }};
     
     registerSnapshotItems(items, sizeof(items));
     
     useReSID = true;
+    updateBufferSize();
 }
 
 SIDBridge::~SIDBridge()
 {
+    delete synthesizer;
+    delete [] ringBuffer;
 }
 
 void
@@ -57,25 +61,110 @@ SIDBridge::reset()
     VirtualComponent::reset();
 
     clearRingbuffer();
-    resid.reset();
-    fastsid.reset();
+    synchronizeSynthesizer();
     
     volume = 100000;
     targetVolume = 100000;
 }
 
+void
+SIDBridge::didLoadFromBuffer(uint8_t **buffer)
+{
+    // Keep the audio stream alive when rolling back after a run-ahead
+    if (!c64->isRunningAhead()) {
+        clearRingbuffer();
+        updateSynthesizer();
+        synchronizeSynthesizer();
+    }
+}
+
 void
 SIDBridge::setClockFrequency(uint32_t frequency)
 {
     debug("Setting clock frequency to %d\n", frequency);
     resid.setClockFrequency(frequency);
     fastsid.setClockFrequency(frequency);
+    synchronizeSynthesizer();
+    
+    // The frame rate has changed
+    updateBufferSize();
 }
 
 void 
 SIDBridge::setReSID(bool enable)
 {
-    useReSID = enable;
+    suspend();
+    
+    if (enable != useReSID) {
+        
+        useReSID = enable;
+        
+        // Bring the selected engine up to date
+        if (useReSID) {
+            resid.loadRegisters(sidreg);
+        } else {
+            fastsid.loadRegisters(sidreg);
+        }
+        clearRingbuffer();
+    }
+    updateSynthesizer();
+    
+    resume();
+}
+
+void
+SIDBridge::setAudioOutput(bool enable)
+{
+    suspend();
+    audioOutput = enable;
+    clearRingbuffer();
+    resume();
+}
+
+bool
+SIDBridge::isSynthesizing()
+{
+    return recorder || (audioOutput && !c64->isWarping());
+}
+
+void
+SIDBridge::setRecorder(WAVWriter *writer)
+{
+    suspend();
+    executeUntil(c64->cpu.cycle);
+    recorder = writer;
+    synthesizing = isSynthesizing();
+    
+    // Recordings are produced with the nominal sample rate
+    rateAdjustment = 0.0;
+    applyRateAdjustment();
+    updateSynthesizer();
+    clearRingbuffer();
+    resume();
+}
+
+void
+SIDBridge::setAsyncSynthesis(bool enable)
+{
+    suspend();
+    asyncSynthesis = enable;
+    updateSynthesizer();
+    resume();
+}
+
+void
+SIDBridge::updateSynthesizer()
+{
+    bool needed = asyncSynthesis && useReSID && !recorder;
+    
+    if (needed && !synthesizer) {
+        synthesizer = new SIDSynthesizer(this);
+        synchronizeSynthesizer();
+    }
+    if (!needed && synthesizer) {
+        delete synthesizer;
+        synthesizer = NULL;
+    }
 }
 
 void
@@ -183,15 +272,190 @@ SIDBridge::spypeek(uint16_t addr)
 void 
 SIDBridge::poke(uint16_t addr, uint8_t value)
 {
+    assert(addr <= 0x1F);
+    
     // Get SID up to date
     executeUntil(c64->cpu.cycle);
 
-    // Keep both SID implementations up to date
+    // Only the selected engine is kept up to date
+    sidreg[addr] = value;
+    
+    if (!useReSID) {
+        fastsid.poke(addr, value);
+        return;
+    }
+    
     resid.poke(addr, value);
-    fastsid.poke(addr, value);
     
-    // Run ReSID for at least one cycle to make pipelined writes work
-    if (!useReSID) resid.clock();
+    // Inform the synthesis thread
+    if (synthesizer && synthesizing && !c64->isRunningAhead()) {
+        synthesizer->write(cycles, addr, value);
+    }
+}
+
+void
+SIDBridge::endFrame()
+{
+    // If no sound samples are computed, SID is only updated when its
+    // registers are accessed
+    if (!isSynthesizing())
+        return;
+    
+    executeUntil(c64->cpu.cycle);
+    
+    if (c64->isRunningAhead() || recorder)
+        return;
+    
+    // Let the synthesis thread compute the samples of this frame
+    if (synthesizer) {
+        synthesizer->sync(cycles);
+    }
+    
+    controlRate();
+}
+
+void
+SIDBridge::controlRate()
+{
+    // Produce more samples if the buffer runs low and less if it fills up
+    double target = (double)samplesAhead;
+    double error = (target - averageFill) / target;
+    error = MAX(-1.0, MIN(1.0, error));
+    
+    driftEstimate += driftGain * error;
+    driftEstimate = MAX(-maxRateAdjustment, MIN(maxRateAdjustment, driftEstimate));
+    
+    rateAdjustment = errorGain * error + driftEstimate;
+    rateAdjustment = MAX(-maxRateAdjustment, MIN(maxRateAdjustment, rateAdjustment));
+    applyRateAdjustment();
+}
+
+void
+SIDBridge::applyRateAdjustment()
+{
+    double rate = (double)getSampleRate() * (1.0 + rateAdjustment);
+    
+    if (useReSID) {
+        resid.adjustSampleRate(rate);
+    } else {
+        fastsid.adjustSampleRate(rate);
+    }
+    if (synthesizer) {
+        synthesizer->adjustSampleRate(rate);
+    }
+}
+
+void
+SIDBridge::setTargetLatency(unsigned ms)
+{
+    debug(2, "Setting target latency to %d ms\n", ms);
+    
+    suspend();
+    targetLatency = ms;
+    updateBufferSize();
+    resume();
+}
+
+void
+SIDBridge::setBufferCapacity(unsigned ms)
+{
+    debug(2, "Setting buffer capacity to %d ms\n", ms);
+    
+    suspend();
+    bufferLatency = ms;
+    updateBufferSize();
+    resume();
+}
+
+double
+SIDBridge::samplesPerFrame()
+{
+    // The VIC model is not known during construction. Assume PAL then.
+    double fps = c64 ? c64->vic.getFramesPerSecond() : 50.125;
+    return (double)getSampleRate() / fps;
+}
+
+void
+SIDBridge::updateBufferSize()
+{
+    double frame = samplesPerFrame();
+    double rate = (double)getSampleRate();
+    
+    // Determine the target fill level (at least one frame)
+    double target = targetLatency ? rate * targetLatency / 1000.0 : 2 * frame;
+    samplesAhead = (uint32_t)ceil(MAX(target, frame));
+    
+    // The buffer must hold the target fill level plus a burst of two frames
+    double needed = samplesAhead + 2 * frame;
+    if (bufferLatency) {
+        needed = MAX(needed, rate * bufferLatency / 1000.0);
+    } else {
+        needed = MAX(needed, 2 * samplesAhead + 4 * frame);
+    }
+    
+    // Round up to a power of two
+    size_t size = minBufferSize;
+    while (size < needed && size < maxBufferSize) size *= 2;
+    
+    debug(2, "Target fill level: %d samples Buffer size: %d samples\n",
+          (uint32_t)samplesAhead, size);
+    
+    if (size != bufferSize) {
+        
+        // Make sure the synthesis thread doesn't write into the buffer
+        synchronizeSynthesizer();
+        allocateRingbuffer(size);
+    }
+}
+
+void
+SIDBridge::allocateRingbuffer(size_t size)
+{
+    assert(size >= minBufferSize && size <= maxBufferSize);
+    assert((size & (size - 1)) == 0);
+    
+    float *newBuffer = new float[size];
+    memset(newBuffer, 0, size * sizeof(float));
+    
+    // Wait until all readers have left the ringbuffer
+    resizing = true;
+    while (activeReaders) {
+        sched_yield();
+    }
+    
+    float *oldBuffer = ringBuffer;
+    ringBuffer = newBuffer;
+    bufferSize = size;
+    bufferMask = (uint32_t)(size - 1);
+    readPtr = 0;
+    writePtr = 0;
+    flushRequest = true;
+    
+    resizing = false;
+    delete [] oldBuffer;
+}
+
+AudioBufferStats
+SIDBridge::getBufferStats()
+{
+    AudioBufferStats stats;
+    
+    stats.capacity = (uint32_t)bufferSize;
+    stats.targetFill = samplesAhead;
+    stats.minFill = minFill.exchange(UINT32_MAX);
+    stats.maxFill = maxFill.exchange(0);
+    stats.underflows = bufferUnderflows - reportedUnderflows;
+    stats.overflows = bufferOverflows - reportedOverflows;
+    stats.rateAdjustment = rateAdjustment;
+    
+    // No samples have been read since the last query
+    if (stats.minFill > stats.maxFill) {
+        stats.minFill = stats.maxFill = samplesInBuffer();
+    }
+    
+    reportedUnderflows = bufferUnderflows;
+    reportedOverflows = bufferOverflows;
+    return stats;
 }
 
 void
@@ -199,13 +463,38 @@ SIDBridge::executeUntil(uint64_t targetCycle)
 {
     uint64_t missingCycles = targetCycle - cycles;
     
-    if (missingCycles > PAL_CYCLES_PER_SECOND) {
-        debug("Far too many SID cycles are missing.\n");
-        missingCycles = PAL_CYCLES_PER_SECOND;
+    if (!isSynthesizing()) {
+        
+        // Only keep track of what the CPU can observe
+        executeSilently(missingCycles);
+        cycles = targetCycle;
+        synthesizing = false;
+        
+    } else if (!synthesizing) {
+        
+        // Sound synthesis has been resumed. The missing cycles still belong
+        // to the silent period and the ringbuffer contains outdated samples.
+        executeSilently(missingCycles);
+        cycles = targetCycle;
+        clearRingbuffer();
+        synchronizeSynthesizer();
+        synthesizing = true;
+        
+    } else if (synthesizer) {
+        
+        // Sound samples are computed by the synthesis thread
+        executeSilently(missingCycles);
+        cycles = targetCycle;
+        
+    } else {
+        
+        if (missingCycles > PAL_CYCLES_PER_SECOND) {
+            debug("Far too many SID cycles are missing.\n");
+            missingCycles = PAL_CYCLES_PER_SECOND;
+        }
+        execute(missingCycles);
+        cycles = targetCycle;
     }
-    
-    execute(missingCycles);
-    cycles = targetCycle;
 }
 
 void
@@ -222,6 +511,15 @@ SIDBridge::execute(uint64_t numCycles)
     }
 }
 
+void
+SIDBridge::executeSilently(uint64_t numCycles)
+{
+    // FastSID doesn't emulate OSC3 and ENV3. Hence, there is nothing to do.
+    if (numCycles && useReSID) {
+        resid.executeSilently(numCycles);
+    }
+}
+
 void 
 SIDBridge::run()
 {
@@ -249,6 +547,7 @@ SIDBridge::setAudioFilter(bool value)
 {
     resid.setAudioFilter(value);
     fastsid.setAudioFilter(value);
+    synchronizeSynthesizer();
 }
 
 SamplingMethod
@@ -263,6 +562,7 @@ SIDBridge::setSamplingMethod(SamplingMethod value)
 {
     // Option is ReSID only
     resid.setSamplingMethod(value);
+    synchronizeSynthesizer();
 }
 
 SIDModel
@@ -286,6 +586,7 @@ SIDBridge::setModel(SIDModel m)
     suspend();
     resid.setModel(m);
     fastsid.setModel(m);
+    synchronizeSynthesizer();
     resume();
 }
 
@@ -303,8 +604,18 @@ void
 SIDBridge::setSampleRate(uint32_t rate)
 {
     debug("Changing sample rate from %d to %d\n", getSampleRate(), rate);
+    
+    suspend();
     resid.setSampleRate(rate);
     fastsid.setSampleRate(rate);
+    synchronizeSynthesizer();
+    updateBufferSize();
+    
+    // Restart the dynamic rate control
+    rateAdjustment = 0.0;
+    driftEstimate = 0.0;
+    averageFill = (double)samplesAhead;
+    resume();
 }
 
 uint32_t
@@ -318,62 +629,128 @@ SIDBridge::getClockFrequency()
 }
 
 void
-SIDBridge::clearRingbuffer()
+SIDBridge::copySamples(float *target, size_t n)
 {
-    debug(4,"Clearing ringbuffer\n");
+    // Output silence while the ringbuffer is replaced
+    activeReaders++;
+    if (resizing) {
+        activeReaders--;
+        memset(target, 0, n * sizeof(float));
+        return;
+    }
     
-    // Reset ringbuffer contents
-    for (unsigned i = 0; i < bufferSize; i++) {
-        ringBuffer[i] = 0.0f;
+    // Process pending requests of the producer
+    if (flushRequest.exchange(false)) {
+        debug(4, "Clearing ringbuffer\n");
+        readPtr.store(writePtr.load(std::memory_order_acquire),
+                      std::memory_order_release);
+        refilling = true;
     }
+    if (skipRequest.exchange(false)) {
+        uint32_t w = writePtr.load(std::memory_order_acquire);
+        if (w - readPtr.load(std::memory_order_relaxed) > samplesAhead) {
+            readPtr.store(w - samplesAhead, std::memory_order_release);
+        }
+    }
+    
+    uint32_t r = readPtr.load(std::memory_order_relaxed);
+    uint32_t w = writePtr.load(std::memory_order_acquire);
+    size_t count = w - r;
     
-    // Put the write pointer ahead of the read pointer
-    alignWritePtr();
+    // Wait until enough samples have been produced after an underflow
+    if (refilling) {
+        if (count < samplesAhead) count = 0; else refilling = false;
+    }
+    
+    // Check for buffer underflow
+    if (!refilling && count < n) {
+        underflowReport.store(true, std::memory_order_release);
+        refilling = true;
+    }
+    
+    // Record the fill level for the statistics
+    uint32_t fill = w - r;
+    if (fill < minFill.load(std::memory_order_relaxed)) minFill = fill;
+    if (fill > maxFill.load(std::memory_order_relaxed)) maxFill = fill;
+    
+    // Keep track of the fill level for the dynamic rate control
+    if (!refilling) {
+        double avg = averageFill.load(std::memory_order_relaxed);
+        double weight = MIN(1.0, (double)n / fillTimeConstant);
+        averageFill.store(avg + weight * ((double)count - avg), std::memory_order_relaxed);
+    }
+    
+    // Copy samples (in two blocks if the buffer wraps around)
+    count = MIN(count, n);
+    size_t pos = r & bufferMask;
+    size_t first = MIN(count, bufferSize - pos);
+    memcpy(target, ringBuffer + pos, first * sizeof(float));
+    memcpy(target + first, ringBuffer, (count - first) * sizeof(float));
+    readPtr.store(r + (uint32_t)count, std::memory_order_release);
+    activeReaders--;
+    
+    // Fill up with silence
+    memset(target + count, 0, (n - count) * sizeof(float));
+    
+    applyVolume(target, n);
 }
 
-float
-SIDBridge::readData()
+void
+SIDBridge::applyVolume(float *target, size_t n)
 {
-    // Read sound sample
-    float value = ringBuffer[readPtr];
+    // float divider = 75000.0f; // useReSID ? 100000.0f : 150000.0f;
+    const float divider = 40000.0f;
     
-    // Adjust volume
-    if (volume != targetVolume) {
-        if (volume < targetVolume) {
-            volume += MIN(volumeDelta, targetVolume - volume);
-        } else {
-            volume -= MIN(volumeDelta, volume - targetVolume);
+    int32_t vol = volume, target_vol = targetVolume, delta = volumeDelta;
+    size_t i = 0;
+    
+    // Ramp phase
+    if (vol != target_vol && delta > 0) {
+        
+        int32_t distance = abs(target_vol - vol);
+        int32_t step = (target_vol > vol) ? delta : -delta;
+        size_t steps = MIN(n, (size_t)((distance + delta - 1) / delta));
+        
+        for (; i < steps; i++) {
+            int32_t v = vol + step * (int32_t)(i + 1);
+            v = (step > 0) ? MIN(v, target_vol) : MAX(v, target_vol);
+            target[i] *= (float)MAX(v, 0) / divider;
         }
+        vol = (steps * delta >= (size_t)distance) ? target_vol : vol + step * (int32_t)steps;
+        volume = vol;
     }
-    // float divider = 75000.0f; // useReSID ? 100000.0f : 150000.0f;
-    float divider = 40000.0f;
-    value = (volume <= 0) ? 0.0f : value * (float)volume / divider;
-    
-    // Advance read pointer
-    advanceReadPtr();
     
+    // Constant phase
+    float gain = (float)MAX(vol, 0) / divider;
+    for (; i < n; i++) {
+        target[i] *= gain;
+    }
+}
+
+float
+SIDBridge::readData()
+{
+    float value;
+    copySamples(&value, 1);
     return value;
 }
 
 float
 SIDBridge::ringbufferData(size_t offset)
 {
-    return ringBuffer[(readPtr + offset) % bufferSize];
+    // Don't touch the ringbuffer while it is replaced
+    activeReaders++;
+    float value = resizing ? 0.0f :
+    ringBuffer[(readPtr.load(std::memory_order_relaxed) + offset) & bufferMask];
+    activeReaders--;
+    
+    return value;
 }
 
 void
 SIDBridge::readMonoSamples(float *target, size_t n)
 {
-    // Check for buffer underflow
-    if (samplesInBuffer() < n) {
-        handleBufferUnderflow();
-    }
-    
-    // Read samples
-    for (size_t i = 0; i < n; i++) {
-        float value = readData();
-        target[i] = value;
-    }
+    copySamples(target, n);
 }
 
 void
@@ -381,29 +758,17 @@ SIDBridge::readStereoSamples(float *target1, float *target2, size_t n)
 {
     // debug("read: %d write: %d Reading %d\n", readPtr, writePtr, n);
 
-    // Check for buffer underflow
-    if (samplesInBuffer() < n) {
-        handleBufferUnderflow();
-    }
-    
-    // Read samples
-    for (unsigned i = 0; i < n; i++) {
-        float value = readData();
-        target1[i] = target2[i] = value;
-    }
+    copySamples(target1, n);
+    memcpy(target2, target1, n * sizeof(float));
 }
 
 void
 SIDBridge::readStereoSamplesInterleaved(float *target, size_t n)
 {
-    // Check for buffer underflow
-    if (samplesInBuffer() < n) {
-        handleBufferUnderflow();
-    }
-    
-    // Read samples
-    for (unsigned i = 0; i < n; i++) {
-        float value = readData();
+    // Read into the upper half and spread the samples out in place
+    copySamples(target + n, n);
+    for (size_t i = 0; i < n; i++) {
+        float value = target[n + i];
         target[i*2] = value;
         target[i*2+1] = value;
     }
@@ -412,74 +777,54 @@ SIDBridge::readStereoSamplesInterleaved(float *target, size_t n)
 void
 SIDBridge::writeData(short *data, size_t count)
 {
-    // debug("  read: %d write: %d Writing %d (%d)\n", readPtr, writePtr, count, bufferCapacity());
+    // Discard samples belonging to frames that will be rolled back
+    if (c64->isRunningAhead())
+        return;
     
-    // Check for buffer overflow
-    if (bufferCapacity() < count) {
-        handleBufferOverflow();
+    // Bypass the ringbuffer when rendering offline
+    if (recorder) {
+        recorder->write(data, count);
+        return;
     }
     
-    // Convert sound samples to floating point values and write into ringbuffer
-    for (unsigned i = 0; i < count; i++) {
-        ringBuffer[writePtr] = float(data[i]) * scale;
-        advanceWritePtr();
-    }
+    writeSamples(data, count);
 }
 
 void
-SIDBridge::handleBufferUnderflow()
+SIDBridge::writeSamples(short *data, size_t count)
 {
-    // There are two common scenarios in which buffer underflows occur:
-    //
-    // (1) The consumer runs slightly faster than the producer.
-    // (2) The producer is halted or not startet yet.
-    
-    debug(2, "SID RINGBUFFER UNDERFLOW (r: %ld w: %ld)\n", readPtr, writePtr);
-
-    // Determine the elapsed seconds since the last pointer adjustment.
-    uint64_t now = mach_absolute_time();
-    double elapsedTime = (double)(now - lastAlignment) / 1000000000.0;
-    lastAlignment = now;
-
-    // Adjust the sample rate, if condition (1) holds.
-    if (elapsedTime > 10.0) {
-        
+    // Count the buffer underflows reported by the consumer
+    if (underflowReport.exchange(false)) {
+        debug(2, "SID RINGBUFFER UNDERFLOW (r: %ld w: %ld)\n", getReadPtr(), getWritePtr());
         bufferUnderflows++;
-        
-        // Increase the sample rate based on what we've measured.
-        int offPerSecond = (int)(samplesAhead / elapsedTime);
-        setSampleRate(getSampleRate() + offPerSecond);
     }
-
-    // Reset the write pointer
-    alignWritePtr();
-}
-
-void
-SIDBridge::handleBufferOverflow()
-{
-    // There are two common scenarios in which buffer overflows occur:
-    //
-    // (1) The consumer runs slightly slower than the producer.
-    // (2) The consumer is halted or not startet yet.
     
-    debug(2, "SID RINGBUFFER OVERFLOW (r: %ld w: %ld)\n", readPtr, writePtr);
+    uint32_t w = writePtr.load(std::memory_order_relaxed);
+    uint32_t r = readPtr.load(std::memory_order_acquire);
+    size_t capacity = bufferSize - (w - r);
     
-    // Determine the elapsed seconds since the last pointer adjustment.
-    uint64_t now = mach_absolute_time();
-    double elapsedTime = (double)(now - lastAlignment) / 1000000000.0;
-    lastAlignment = now;
+    // debug("  read: %d write: %d Writing %d (%d)\n", r, w, count, capacity);
     
-    // Adjust the sample rate, if condition (1) holds.
-    if (elapsedTime > 10.0) {
+    // Check for buffer overflow (samples that don't fit are dropped)
+    if (capacity < count) {
         
+        // This only happens if the consumer has stopped reading. The
+        // dynamic rate control cannot compensate this. Hence, we ask the
+        // consumer to skip the oldest samples.
+        debug(2, "SID RINGBUFFER OVERFLOW (r: %ld w: %ld)\n", getReadPtr(), getWritePtr());
         bufferOverflows++;
-        
-        // Decrease the sample rate based on what we've measured.
-        int offPerSecond = (int)(samplesAhead / elapsedTime);
-        setSampleRate(getSampleRate() - offPerSecond);
+        skipRequest = true;
+        count = capacity;
     }
     
-    // Reset the write pointer
-    alignWritePtr();
+    // Convert sound samples to floating point values and write into ringbuffer
+    size_t pos = w & bufferMask;
+    size_t first = MIN(count, bufferSize - pos);
+    for (size_t i = 0; i < first; i++) {
+        ringBuffer[pos + i] = float(data[i]) * scale;
+    }
+    for (size_t i = first; i < count; i++) {
+        ringBuffer[i - first] = float(data[i]) * scale;
+    }
+    writePtr.store(w + (uint32_t)count, std::memory_order_release);
 }
@@ -24,7 +24,10 @@
 #include "VirtualComponent.h"
 #include "FastSID.h"
 #include "ReSID.h"
+#include "SIDSynthesizer.h"
+#include "WAVWriter.h"
 #include "SID_types.h"
+#include <atomic>
 
 class SIDBridge : public VirtualComponent {
 
@@ -41,12 +44,47 @@ private:
     //! @brief    SID selector
     bool useReSID;
     
+    /*! @brief    Register shadow
+     *  @details  Stores the last value written into each SID register. Only
+     *            the selected sound engine receives register writes. The
+     *            other engine is brought up to date with these values when
+     *            it gets selected.
+     */
+    uint8_t sidreg[0x20];
+    
+    /*! @brief    Indicates whether sound samples should be computed
+     *  @details  If audio output is disabled, SID only keeps track of what
+     *            can be observed by the CPU, i.e., the OSC3 and ENV3 registers
+     *            of the third voice and the potentiometer registers. Sound
+     *            synthesis is also skipped in warp mode.
+     */
+    bool audioOutput = true;
+    
+    //! @brief    Indicates whether sound samples have been computed lately
+    bool synthesizing = true;
+    
+    /*! @brief    Indicates whether sound samples are computed asynchronously
+     *  @details  If set to true, reSID's sound synthesis is carried out by a
+     *            separate thread. Has no effect when FastSID is selected.
+     */
+    bool asyncSynthesis = false;
+    
+    /*! @brief    The synthesis thread
+     *  @details  Exists iff asynchronous synthesis is enabled and reSID is
+     *            used.
+     */
+    SIDSynthesizer *synthesizer = NULL;
+    
+    /*! @brief    Receives all sound samples while audio is rendered offline
+     *  @details  If set, sound samples bypass the ringbuffer and are also
+     *            computed in warp mode.
+     *  @see      C64::renderAudio()
+     */
+    WAVWriter *recorder = NULL;
+    
     //! @brief    CPU cycle at the last call to executeUntil()
     uint64_t cycles;
     
-    //! @brief    Time stamp of the last write pointer alignment
-    uint64_t lastAlignment = 0;
-    
 public:
     
     //! @brief    Number of buffer underflows since power up
@@ -55,20 +93,92 @@ public:
     //! @brief    Number of buffer overflows since power up
     uint64_t bufferOverflows;
 
+private:
+    
+    //
+    // Dynamic rate control
+    //
+    
+    /*! @brief    Audio latency aimed at in milliseconds
+     *  @details  The dynamic rate control keeps this amount of audio in the
+     *            ringbuffer by slightly varying the number of samples that
+     *            are computed per second. If set to 0, the target latency
+     *            is two frames.
+     */
+    unsigned targetLatency = 0;
+    
+    //! @brief    Maximum relative deviation from the nominal sample rate
+    static constexpr double maxRateAdjustment = 0.005;
+    
+    /*! @brief    Time constant of the averaged fill level in samples
+     *  @details  With a standard sample rate of 44100 Hz, the average covers
+     *            about a quarter of a second.
+     */
+    static constexpr double fillTimeConstant = 11025.0;
+    
+    //! @brief    Weight of the fill level error in the rate adjustment
+    static constexpr double errorGain = 4 * maxRateAdjustment;
+    
+    //! @brief    Weight of the fill level error in the drift estimation
+    static constexpr double driftGain = 0.00001;
+    
+    /*! @brief    Averaged number of samples in the ringbuffer
+     *  @details  The fill level is sampled by the consumer before each read.
+     *            Hence, the average doesn't depend on whether the samples of
+     *            a frame are written by the emulator thread or by the
+     *            synthesis thread.
+     */
+    std::atomic<double> averageFill { 0.0 };
+    
+    /*! @brief    Estimated clock drift between the emulator and the consumer
+     *  @details  The fill level error is accumulated in this variable. It
+     *            makes the fill level converge to the target fill level if
+     *            the audio device runs slightly faster or slower than the
+     *            emulator.
+     */
+    double driftEstimate = 0.0;
+    
+    /*! @brief    Current relative deviation from the nominal sample rate
+     *  @details  The sound engine computes sampleRate * (1 + rateAdjustment)
+     *            samples per second.
+     */
+    double rateAdjustment = 0.0;
+
 private:
     
     //
     // Audio ringbuffer
     //
     
+    /*! @brief   Requested capacity of the ringbuffer in milliseconds
+     *  @details If set to 0, the capacity is derived from the target fill
+     *           level and the number of samples produced per frame.
+     *  @see     updateBufferSize()
+     */
+    unsigned bufferLatency = 0;
+    
+    //! @brief   Smallest and largest supported ringbuffer size
+    static constexpr size_t minBufferSize = 1024;
+    static constexpr size_t maxBufferSize = 262144;
+    
     //! @brief   Number of sound samples stored in ringbuffer
-    static constexpr size_t bufferSize = 12288;
+    /*! @note    Always a power of two
+     */
+    size_t bufferSize = 0;
+    
+    //! @brief   Bit mask for mapping a read or write pointer into the buffer
+    uint32_t bufferMask = 0;
     
     /*! @brief   The audio sample ringbuffer.
      *  @details This ringbuffer serves as the data interface between the
      *           emulation code and the audio API (CoreAudio on Mac OS X).
+     *           It is organized as a lock-free single-producer /
+     *           single-consumer queue. The emulator thread is the only
+     *           thread modifying the write pointer and the audio thread is
+     *           the only thread modifying the read pointer. Whenever one side
+     *           needs the other side to move its pointer, it places a request.
      */
-    float ringBuffer[bufferSize];
+    float *ringBuffer = NULL;
     
     /*! @brief   Scaling value for sound samples
      *  @details All sound samples produced by reSID are scaled by this
@@ -77,25 +187,67 @@ private:
     static constexpr float scale = 0.000005f;
     
     /*! @brief   Ring buffer read pointer
+     *  @details Both pointers are never wrapped around. Their difference is
+     *           the number of samples in the buffer.
      */
-    uint32_t readPtr;
+    std::atomic<uint32_t> readPtr { 0 };
     
     /*! @brief   Ring buffer write pointer
      */
-    uint32_t writePtr;
+    std::atomic<uint32_t> writePtr { 0 };
+    
+    //! @brief   Asks the consumer to discard all samples in the buffer
+    std::atomic<bool> flushRequest { true };
+    
+    //! @brief   Asks the consumer to skip samples after a buffer overflow
+    std::atomic<bool> skipRequest { false };
+    
+    //! @brief   Informs the producer about a buffer underflow
+    std::atomic<bool> underflowReport { false };
+    
+    /*! @brief   Indicates that the consumer waits for the buffer to fill up
+     *  @details This variable is accessed by the consumer, only.
+     */
+    bool refilling = true;
+    
+    /*! @brief   Handshake variables for replacing the ringbuffer
+     *  @details Each reader increments activeReaders while it accesses the
+     *           ringbuffer. Besides the audio thread, the GUI peeks into the
+     *           buffer to draw the waveform. While resizing is set, readers
+     *           return silence instead. The audio thread is never blocked
+     *           this way.
+     *  @see     allocateRingbuffer()
+     */
+    std::atomic<unsigned> activeReaders { 0 };
+    std::atomic<bool> resizing { false };
+    
+    
+    //
+    // Ringbuffer statistics
+    //
+    
+    /*! @brief   Smallest and largest fill level seen by the consumer
+     *  @details Both values are reset by getBufferStats().
+     */
+    std::atomic<uint32_t> minFill { UINT32_MAX };
+    std::atomic<uint32_t> maxFill { 0 };
+    
+    //! @brief   Under- and overflow counters at the last statistics query
+    uint64_t reportedUnderflows = 0;
+    uint64_t reportedOverflows = 0;
     
     /*! @brief   Current volume
      *  @note    A value of 0 or below silences the audio playback.
      */
-    int32_t volume;
+    std::atomic<int32_t> volume;
     
     /*! @brief   Target volume
-     *  @details Whenever an audio sample is written, the volume is
+     *  @details Whenever an audio sample is read, the volume is
      *           increased or decreased by volumeDelta to make it reach
      *           the target volume eventually. This feature simulates a
      *           fading effect.
      */
-    int32_t targetVolume;
+    std::atomic<int32_t> targetVolume;
     
     /*! @brief   Maximum volume
      */
@@ -105,9 +257,9 @@ private:
      *  @details If the current volume does not match the target volume,
      *           it is increased or decreased by the specified amount. The
      *           increase or decrease takes place whenever an audio sample
-     *           is generated.
+     *           is read.
      */
-    int32_t volumeDelta;
+    std::atomic<int32_t> volumeDelta;
     
 public:
 	
@@ -121,7 +273,14 @@ public:
     void reset();
     void dump();
     void setClockFrequency(uint32_t frequency);
-    void didLoadFromBuffer(uint8_t **buffer) { clearRingbuffer(); }
+    void didLoadFromBuffer(uint8_t **buffer);
+    
+    /*! @brief    Method from VirtualComponent
+     *  @details  The fingerprint covers the SID registers, only. The internal
+     *            state of the sound engines is excluded, because it depends on
+     *            the audio sample rate which is adjusted on-the-fly.
+     */
+    uint64_t fingerprint() { return fnv_1a_64(sidreg, 0x19); }
     
 	//! @brief    Prints debug information
     void dump(SIDInfo info);
@@ -140,9 +299,55 @@ public:
     //! @brief    Returns true, whether ReSID or the old implementation should be used.
     bool getReSID() { return useReSID; }
     
-    //! @brief    Enables or disables the ReSID library.
+    /*! @brief    Enables or disables the ReSID library.
+     *  @details  The newly selected sound engine is brought up to date with
+     *            the contents of the register shadow.
+     */
     void setReSID(bool enable);
     
+    //! @brief    Returns true if audio output is enabled.
+    bool getAudioOutput() { return audioOutput; }
+    
+    /*! @brief    Enables or disables audio output.
+     *  @details  Disabling audio output is meant for headless runs. The
+     *            emulated SID registers stay fully functional.
+     */
+    void setAudioOutput(bool enable);
+    
+    /*! @brief    Returns true if sound samples are currently computed.
+     *  @details  Sound synthesis is skipped if audio output is disabled or if
+     *            the emulator runs in warp mode, unless sound samples are
+     *            recorded.
+     */
+    bool isSynthesizing();
+    
+    //! @brief    Returns true if sound samples are redirected into a file.
+    bool isRecording() { return recorder != NULL; }
+    
+    /*! @brief    Redirects all sound samples into a WAV file.
+     *  @details  SID is brought up to date before the redirection takes
+     *            effect. Hence, the file only receives the samples of the
+     *            cycles emulated afterwards. Pass NULL to stop recording.
+     *            Asynchronous synthesis is disabled while recording.
+     */
+    void setRecorder(WAVWriter *writer);
+    
+    //! @brief    Returns true if sound samples are computed asynchronously.
+    bool getAsyncSynthesis() { return asyncSynthesis; }
+    
+    //! @brief    Enables or disables the synthesis thread.
+    void setAsyncSynthesis(bool enable);
+    
+private:
+    
+    //! @brief    Launches or terminates the synthesis thread as needed.
+    void updateSynthesizer();
+    
+    //! @brief    Brings the synthesis thread in sync with the emulator state.
+    void synchronizeSynthesizer() { if (synthesizer) synthesizer->synchronize(&resid, cycles); }
+    
+public:
+    
     //! @brief    Returns the simulated chip model.
     SIDModel getModel();
     
@@ -191,13 +396,13 @@ public:
     /*! @brief   Triggers volume ramp up phase
      *  @details Configures volume and targetVolume to simulate a smooth audio fade in
      */
-    void rampUp() { targetVolume = maxVolume; volumeDelta = 3; ignoreNextUnderOrOverflow(); }
+    void rampUp() { targetVolume = maxVolume; volumeDelta = 3; }
     void rampUpFromZero() { volume = 0; rampUp(); }
     
     /*! @brief   Triggers volume ramp down phase
      *  @details Configures volume and targetVolume to simulate a quick audio fade out
      */
-    void rampDown() { targetVolume = 0; volumeDelta = 50; ignoreNextUnderOrOverflow(); }
+    void rampDown() { targetVolume = 0; volumeDelta = 50; }
     
     //
     // Ringbuffer handling
@@ -206,14 +411,35 @@ public:
     //! @brief  Returns the size of the ringbuffer
     size_t ringbufferSize() { return bufferSize; }
     
+    /*! @brief  Returns the requested ringbuffer capacity in milliseconds
+     *  @return 0, if the capacity is chosen automatically
+     */
+    unsigned getBufferCapacity() { return bufferLatency; }
+    
+    /*! @brief  Sets the ringbuffer capacity in milliseconds
+     *  @details The capacity is rounded up to the next power of two and
+     *           never smaller than needed for the target fill level plus
+     *           two frames. Pass 0 to let the emulator choose the capacity.
+     */
+    void setBufferCapacity(unsigned ms);
+    
+    /*! @brief  Returns statistics about the ringbuffer
+     *  @details Under- and overflows as well as the minimum and maximum fill
+     *           level refer to the time since the last call.
+     */
+    AudioBufferStats getBufferStats();
+    
     //! @brief  Returns the position of the read pointer
-    uint32_t getReadPtr() { return readPtr; }
+    uint32_t getReadPtr() { return readPtr & bufferMask; }
 
     //! @brief  Returns the position of the write pointer
-    uint32_t getWritePtr() { return writePtr; }
+    uint32_t getWritePtr() { return writePtr & bufferMask; }
 
-    //! @brief  Clears the ringbuffer and resets the read and write pointer
-    void clearRingbuffer();
+    /*! @brief  Clears the ringbuffer
+     *  @details The samples are discarded by the consumer. Playback resumes
+     *           when enough new samples have been written.
+     */
+    void clearRingbuffer() { flushRequest = true; }
     
     //! @brief  Reads a single audio sample from the ringbuffer
     float readData();
@@ -237,52 +463,93 @@ public:
     void readStereoSamplesInterleaved(float *target, size_t n);
     
     /*! @brief  Writes a certain number of audio samples into ringbuffer
+     *  @details Samples are discarded if the emulator is running ahead and
+     *           redirected if a recorder is set.
      */
     void writeData(short *data, size_t count);
     
-    /*! @brief   Handles a buffer underflow condition.
-     *  @details A buffer underflow occurs when the computer's audio device
-     *           needs sound samples than SID hasn't produced, yet.
+    /*! @brief  Writes a certain number of audio samples into ringbuffer
+     *  @details This function is called by the thread producing the samples.
+     */
+    void writeSamples(short *data, size_t count);
+    
+private:
+    
+    /*! @brief   Copies samples from the ringbuffer and applies the volume
+     *  @details Processes pending requests of the producer first. If not
+     *           enough samples are available, the missing samples are
+     *           replaced by silence. This function is called by the
+     *           consumer, only.
      */
-    void handleBufferUnderflow();
+    void copySamples(float *target, size_t n);
     
-    /*! @brief   Handles a buffer overflow condition
-     *  @details A buffer overflow occurs when SID is producing more samples
-     *           than the computer's audio device is able to consume.
+    /*! @brief   Scales a block of samples by the current volume
+     *  @details The volume ramp is computed for the whole block at once.
      */
-    void handleBufferOverflow();
+    void applyVolume(float *target, size_t n);
+    
+    /*! @brief   Adjusts the sample production to the consumer
+     *  @details This function implements the dynamic rate control. It is
+     *           called at the end of each frame. It compares the averaged
+     *           fill level of the ringbuffer with the target fill level and
+     *           varies the number of samples computed per second by up to
+     *           maxRateAdjustment. The adjustment is the sum of a term
+     *           proportional to the fill level error and the accumulated
+     *           error (driftEstimate). The sound engines are not reconfigured
+     *           and the read and write pointers stay untouched.
+     */
+    void controlRate();
     
-    //! @brief   Signals to ignore the next underflow or overflow condition.
-    void ignoreNextUnderOrOverflow() { lastAlignment = mach_absolute_time(); }
-        
-    //! @brief   Moves read pointer one position forward
-    void advanceReadPtr() { readPtr = (readPtr + 1) % bufferSize; }
+    //! @brief   Passes the current rate adjustment to the sound engines
+    void applyRateAdjustment();
     
-    //! @brief   Moves read pointer forward or backward
-    void advanceReadPtr(int steps) { readPtr = (readPtr + bufferSize + steps) % bufferSize; }
+    //! @brief   Returns the number of samples computed per frame
+    double samplesPerFrame();
     
-    //! @brief   Moves write pointer one position forward
-    void advanceWritePtr() { writePtr = (writePtr + 1) % bufferSize; }
+    /*! @brief   Recomputes the target fill level and the ringbuffer size
+     *  @details Both values depend on the sample rate and the frame rate.
+     *           This function is called whenever one of them changes or
+     *           the user requests a different latency or capacity.
+     */
+    void updateBufferSize();
     
-    //! @brief   Moves write pointer forward or backward
-    void advanceWritePtr(int steps) { writePtr = (writePtr + bufferSize + steps) % bufferSize; }
+    /*! @brief   Replaces the ringbuffer by an empty buffer of the given size
+     *  @details Must not be called while the emulator thread or the
+     *           synthesis thread are producing samples.
+     */
+    void allocateRingbuffer(size_t size);
+    
+public:
     
     //! @brief   Returns number of stored samples in ringbuffer
-    unsigned samplesInBuffer() { return (writePtr + bufferSize - readPtr) % bufferSize; }
+    unsigned samplesInBuffer() { return writePtr - readPtr; }
     
     //! @brief   Returns remaining storage capacity of ringbuffer
-    unsigned bufferCapacity() { return (readPtr + bufferSize - writePtr) % bufferSize; }
+    unsigned bufferCapacity() { return bufferSize - samplesInBuffer(); }
     
     //! @brief   Returns the fill level as a percentage value
     double fillLevel() { return (double)samplesInBuffer() / (double)bufferSize; }
     
-    /*! @brief    Aligns the write pointer.
-     *  @details  This function puts the write pointer somewhat ahead of the
-     *            read pointer. With a standard sample rate of 44100 Hz, 735
-     *            samples is 1/60 sec.
+    /*! @brief    Number of buffered samples aimed at.
+     *  @details  After the buffer has been cleared or has run empty, playback
+     *            resumes when this number of samples is available. The value
+     *            is derived from the target latency, the sample rate, and
+     *            the frame rate. It is never smaller than one frame.
+     */
+    std::atomic<uint32_t> samplesAhead { 44100 * 40 / 1000 };
+    
+    /*! @brief    Returns the audio latency aimed at in milliseconds.
+     *  @return   0, if the latency is chosen automatically
+     */
+    unsigned getTargetLatency() { return targetLatency; }
+    
+    /*! @brief    Sets the audio latency aimed at in milliseconds.
+     *  @details  Pass 0 to aim at two frames.
      */
-    const uint32_t samplesAhead = 8 * 735;
-    void alignWritePtr() { writePtr = (readPtr  + samplesAhead) % bufferSize; }
+    void setTargetLatency(unsigned ms);
+    
+    //! @brief    Returns the current relative deviation from the sample rate.
+    double getRateAdjustment() { return rateAdjustment; }
     
 public:
     
@@ -291,10 +558,23 @@ public:
      */
     void executeUntil(uint64_t targetCycle);
 
+    /*! @brief    Executes SID up to the end of the current frame
+     *  @details  This function is called by the C64 at the end of each frame.
+     */
+    void endFrame();
+    
     /*! @brief    Executes SID for a certain number of cycles
      *  @param    cycles Number of cycles to execute
      */
 	void execute(uint64_t numCycles);
+    
+    /*! @brief    Executes SID for a certain number of cycles without
+     *            computing sound samples
+     *  @details  This function is used when audio output is disabled. In
+     *            this case, SID is only brought up to date when one of its
+     *            registers is accessed.
+     */
+    void executeSilently(uint64_t numCycles);
 
      
 	//
@@ -0,0 +1,194 @@
+/*!
+ * @file        SIDSynthesizer.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "C64.h"
+
+void
+*synthesisThread(void *thisSynthesizer)
+{
+    assert(thisSynthesizer != NULL);
+
+    SIDSynthesizer *synthesizer = (SIDSynthesizer *)thisSynthesizer;
+    synthesizer->run();
+    pthread_exit(NULL);
+}
+
+SIDSynthesizer::SIDSynthesizer(SIDBridge *bridge)
+{
+    setDescription("SIDSynthesizer");
+
+    assert(bridge != NULL);
+    this->bridge = bridge;
+    sid = new reSID::SID();
+
+    pthread_mutex_init(&wakeLock, NULL);
+    pthread_mutex_init(&synthLock, NULL);
+    pthread_cond_init(&wakeCond, NULL);
+    pthread_create(&thread, NULL, synthesisThread, (void *)this);
+}
+
+SIDSynthesizer::~SIDSynthesizer()
+{
+    // Terminate the synthesis thread
+    stopRequested = true;
+    wakeUp();
+    pthread_join(thread, NULL);
+
+    pthread_cond_destroy(&wakeCond);
+    pthread_mutex_destroy(&synthLock);
+    pthread_mutex_destroy(&wakeLock);
+    delete sid;
+}
+
+void
+SIDSynthesizer::synchronize(ReSID *resid, uint64_t cycle)
+{
+    // Wait until the queue has been processed
+    while (readPtr.load(std::memory_order_acquire) != writePtr) {
+        wakeUp();
+        sched_yield();
+    }
+
+    // Copy over state and configuration while the thread is idle
+    pthread_mutex_lock(&synthLock);
+    sid->set_chip_model((reSID::chip_model)resid->getModel());
+    sid->set_sampling_parameters((double)resid->getClockFrequency(),
+                                 (reSID::sampling_method)resid->getSamplingMethod(),
+                                 (double)resid->getSampleRate());
+    sid->enable_filter(resid->getAudioFilter());
+    sid->write_state(resid->sid->read_state());
+    this->cycle = cycle;
+    appliedRate = 0.0;
+    pthread_mutex_unlock(&synthLock);
+
+    debug(2, "Synchronized at cycle %lld\n", cycle);
+}
+
+void
+SIDSynthesizer::write(uint64_t cycle, uint8_t addr, uint8_t value)
+{
+    push(SIDEvent { cycle, addr, value, true });
+}
+
+void
+SIDSynthesizer::sync(uint64_t cycle)
+{
+    push(SIDEvent { cycle, 0, 0, false });
+    wakeUp();
+}
+
+void
+SIDSynthesizer::push(SIDEvent event)
+{
+    uint32_t w = writePtr.load(std::memory_order_relaxed);
+
+    // Wait for the synthesis thread if the queue is full
+    while (w - readPtr.load(std::memory_order_acquire) == queueSize) {
+        wakeUp();
+        sched_yield();
+    }
+
+    queue[w & (queueSize - 1)] = event;
+    writePtr.store(w + 1, std::memory_order_release);
+}
+
+void
+SIDSynthesizer::wakeUp()
+{
+    pthread_mutex_lock(&wakeLock);
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&wakeLock);
+}
+
+void
+SIDSynthesizer::run()
+{
+    debug(2, "Synthesis thread started\n");
+
+    while (1) {
+
+        // Sleep until there is something to do
+        pthread_mutex_lock(&wakeLock);
+        while (readPtr.load(std::memory_order_relaxed) ==
+               writePtr.load(std::memory_order_acquire) && !stopRequested) {
+            pthread_cond_wait(&wakeCond, &wakeLock);
+        }
+        pthread_mutex_unlock(&wakeLock);
+
+        if (stopRequested)
+            break;
+
+        pthread_mutex_lock(&synthLock);
+        processEvents();
+        pthread_mutex_unlock(&synthLock);
+    }
+
+    debug(2, "Synthesis thread terminated\n");
+}
+
+void
+SIDSynthesizer::processEvents()
+{
+    short buf[2048];
+    const int buflength = 2048;
+    int bufindex = 0;
+
+    uint32_t r = readPtr.load(std::memory_order_relaxed);
+    uint32_t w = writePtr.load(std::memory_order_acquire);
+
+    // Apply the latest adjustment of the dynamic rate control
+    double rate = adjustedRate.load(std::memory_order_relaxed);
+    if (rate > 0.0 && rate != appliedRate) {
+        sid->adjust_sampling_frequency(rate);
+        appliedRate = rate;
+    }
+
+    for (; r != w; r++) {
+
+        SIDEvent &event = queue[r & (queueSize - 1)];
+
+        // Let reSID compute the sound samples up to the event
+        if (event.cycle > cycle) {
+
+            reSID::cycle_count delta_t =
+            (reSID::cycle_count)MIN(event.cycle - cycle, PAL_CYCLES_PER_SECOND);
+
+            while (delta_t) {
+                bufindex += sid->clock(delta_t, buf + bufindex, buflength - bufindex);
+                if (bufindex == buflength) {
+                    bridge->writeSamples(buf, bufindex);
+                    bufindex = 0;
+                }
+            }
+            cycle = event.cycle;
+        }
+
+        if (event.write) {
+            sid->write(event.addr, event.value);
+        }
+    }
+    readPtr.store(r, std::memory_order_release);
+
+    // Write the remaining samples into the ringbuffer
+    if (bufindex) {
+        bridge->writeSamples(buf, bufindex);
+    }
+}
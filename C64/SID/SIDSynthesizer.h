@@ -0,0 +1,174 @@
+/*!
+ * @header      SIDSynthesizer.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _SIDSYNTHESIZER_H
+#define _SIDSYNTHESIZER_H
+
+#include "VC64Object.h"
+#include "resid/sid.h"
+#include <atomic>
+#include <pthread.h>
+
+class SIDBridge;
+class ReSID;
+
+/*! @brief    Runs reSID's sound synthesis on a separate thread
+ *  @details  The emulator thread doesn't compute any sound samples in this
+ *            mode. It records all SID register writes together with the
+ *            cycle they happened in and puts them into a lock-free queue.
+ *            The synthesis thread replays the writes on its own reSID
+ *            instance and writes the produced samples into the audio
+ *            ringbuffer.
+ *            Register reads are answered by the reSID instance of the
+ *            emulator thread, which is clocked without computing sound
+ *            samples (see ReSID::executeSilently()).
+ */
+class SIDSynthesizer : public VC64Object {
+
+    //! @brief    A queued SID event
+    typedef struct {
+
+        //! @brief    CPU cycle of the event
+        uint64_t cycle;
+
+        //! @brief    Register address and value (write events only)
+        uint8_t addr;
+        uint8_t value;
+
+        //! @brief    Indicates a register write (otherwise, SID is only clocked)
+        bool write;
+
+    } SIDEvent;
+
+    //! @brief    Pointer to bridge object
+    SIDBridge *bridge;
+
+    //! @brief    The reSID instance producing the sound samples
+    reSID::SID *sid;
+
+    //! @brief    CPU cycle reSID has been clocked up to
+    /*! @details  This variable is accessed by the synthesis thread, only.
+     */
+    uint64_t cycle = 0;
+    
+    //! @brief    Sample rate requested by the dynamic rate control
+    std::atomic<double> adjustedRate { 0.0 };
+    
+    /*! @brief    Sample rate the reSID instance has been adjusted to
+     *  @details  This variable is accessed by the synthesis thread, only.
+     */
+    double appliedRate = 0.0;
+
+
+    //
+    // Event queue
+    //
+
+    //! @brief    Number of entries in the event queue (must be a power of two)
+    static constexpr size_t queueSize = 65536;
+
+    //! @brief    The event queue
+    SIDEvent queue[queueSize];
+
+    /*! @brief    Queue read and write pointers
+     *  @details  The queue is a single-producer / single-consumer queue.
+     *            The emulator thread only modifies the write pointer and the
+     *            synthesis thread only modifies the read pointer.
+     */
+    std::atomic<uint32_t> readPtr { 0 };
+    std::atomic<uint32_t> writePtr { 0 };
+
+
+    //
+    // Thread management
+    //
+
+    //! @brief    The synthesis thread
+    pthread_t thread;
+
+    //! @brief    Mutex and condition variable for waking up the thread
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wakeCond;
+
+    /*! @brief    Mutex held by the synthesis thread while processing events
+     *  @details  The emulator thread acquires this mutex to reconfigure the
+     *            reSID instance.
+     */
+    pthread_mutex_t synthLock;
+
+    //! @brief    Asks the synthesis thread to terminate
+    std::atomic<bool> stopRequested { false };
+
+public:
+
+    //! @brief    Constructor
+    /*! @details  Launches the synthesis thread.
+     */
+    SIDSynthesizer(SIDBridge *bridge);
+
+    //! @brief    Destructor
+    /*! @details  Terminates the synthesis thread.
+     */
+    ~SIDSynthesizer();
+
+    /*! @brief    Brings the reSID instance in sync with the emulator
+     *  @details  Waits until all queued events have been processed and copies
+     *            over the state and configuration of the given reSID instance.
+     *            This function is called on startup and whenever the emulator
+     *            has changed the SID state in a way that cannot be expressed
+     *            by register writes (reset, snapshot restore, configuration
+     *            changes).
+     *  @param    resid The reSID instance of the emulator thread
+     *  @param    cycle The CPU cycle the state belongs to
+     */
+    void synchronize(ReSID *resid, uint64_t cycle);
+
+    /*! @brief    Changes the number of samples computed per second
+     *  @details  The new rate is applied by the synthesis thread before it
+     *            processes the next events.
+     *  @see      ReSID::adjustSampleRate()
+     */
+    void adjustSampleRate(double rate) { adjustedRate = rate; }
+    
+    //! @brief    Records a register write
+    void write(uint64_t cycle, uint8_t addr, uint8_t value);
+
+    /*! @brief    Wakes up the synthesis thread
+     *  @details  The thread computes all sound samples up to the given cycle.
+     *            This function is called at the end of each frame.
+     */
+    void sync(uint64_t cycle);
+
+    //! @brief    The thread function
+    void run();
+
+private:
+
+    //! @brief    Puts an event into the queue
+    void push(SIDEvent event);
+
+    //! @brief    Wakes up the synthesis thread
+    void wakeUp();
+
+    //! @brief    Processes all queued events
+    void processEvents();
+};
+
+#endif
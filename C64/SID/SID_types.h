@@ -74,4 +74,18 @@ typedef struct {
     uint8_t potY;
 } SIDInfo;
 
+/*! @brief    Audio ringbuffer statistics
+ *  @details  Returned by SIDBridge::getBufferStats(). All fill levels are
+ *            measured in samples.
+ */
+typedef struct {
+    uint32_t capacity;
+    uint32_t targetFill;
+    uint32_t minFill;
+    uint32_t maxFill;
+    uint64_t underflows;
+    uint64_t overflows;
+    double rateAdjustment;
+} AudioBufferStats;
+
 #endif
@@ -0,0 +1,152 @@
+/*!
+ * @file        WAVWriter.cpp
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "WAVWriter.h"
+
+// Size of the RIFF / WAVE file header in bytes
+static const size_t headerSize = 44;
+
+// Stores a value in little endian format
+static void
+put16(uint8_t **ptr, uint16_t value)
+{
+    *(*ptr)++ = LO_BYTE(value);
+    *(*ptr)++ = HI_BYTE(value);
+}
+
+static void
+put32(uint8_t **ptr, uint32_t value)
+{
+    put16(ptr, (uint16_t)(value & 0xFFFF));
+    put16(ptr, (uint16_t)(value >> 16));
+}
+
+WAVWriter::WAVWriter()
+{
+    setDescription("WAVWriter");
+}
+
+WAVWriter::~WAVWriter()
+{
+    if (file) close();
+}
+
+bool
+WAVWriter::open(const char *filename, uint32_t sampleRate)
+{
+    assert(filename != NULL);
+    
+    if (file) close();
+    
+    if (!(file = fopen(filename, "wb"))) {
+        warn("Cannot create file %s\n", filename);
+        return false;
+    }
+    
+    this->sampleRate = sampleRate;
+    samples = 0;
+    failed = false;
+    writeHeader(0);
+    return !failed;
+}
+
+bool
+WAVWriter::close()
+{
+    if (!file)
+        return false;
+    
+    // The RIFF format limits the data chunk to 4 GB
+    uint64_t dataSize = samples * sizeof(int16_t);
+    if (dataSize > 0xFFFFFFFF - headerSize) {
+        warn("WAV file exceeds 4 GB. The header is truncated.\n");
+        dataSize = 0xFFFFFFFF - headerSize;
+    }
+    
+    // Complete the header
+    if (fseek(file, 0, SEEK_SET) != 0) {
+        failed = true;
+    } else {
+        writeHeader((uint32_t)dataSize);
+    }
+    
+    if (fclose(file) != 0) failed = true;
+    file = NULL;
+    
+    return !failed;
+}
+
+void
+WAVWriter::write(const short *data, size_t count)
+{
+    assert(data != NULL);
+    
+    if (!file || !count)
+        return;
+    
+    // WAV files store samples in little endian format
+    uint8_t buffer[4096];
+    while (count) {
+        
+        size_t chunk = MIN(count, sizeof(buffer) / 2);
+        uint8_t *ptr = buffer;
+        for (size_t i = 0; i < chunk; i++) {
+            put16(&ptr, (uint16_t)data[i]);
+        }
+        if (fwrite(buffer, 2, chunk, file) != chunk) {
+            failed = true;
+        }
+        samples += chunk;
+        data += chunk;
+        count -= chunk;
+    }
+}
+
+void
+WAVWriter::writeHeader(uint32_t dataSize)
+{
+    uint8_t header[headerSize];
+    uint8_t *ptr = header;
+    
+    // RIFF chunk
+    memcpy(ptr, "RIFF", 4); ptr += 4;
+    put32(&ptr, (uint32_t)(headerSize - 8 + dataSize));
+    memcpy(ptr, "WAVE", 4); ptr += 4;
+    
+    // Format chunk (PCM, 1 channel, 16 bit)
+    memcpy(ptr, "fmt ", 4); ptr += 4;
+    put32(&ptr, 16);
+    put16(&ptr, 1);
+    put16(&ptr, 1);
+    put32(&ptr, sampleRate);
+    put32(&ptr, sampleRate * 2);
+    put16(&ptr, 2);
+    put16(&ptr, 16);
+    
+    // Data chunk
+    memcpy(ptr, "data", 4); ptr += 4;
+    put32(&ptr, dataSize);
+    assert(ptr - header == headerSize);
+    
+    if (fwrite(header, 1, headerSize, file) != headerSize) {
+        failed = true;
+    }
+}
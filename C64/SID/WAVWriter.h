@@ -0,0 +1,83 @@
+/*!
+ * @header      WAVWriter.h
+ * @author      Dirk W. Hoffmann, www.dirkwhoffmann.de
+ * @copyright   Dirk W. Hoffmann. All rights reserved.
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _WAVWRITER_INC
+#define _WAVWRITER_INC
+
+#include "VC64Object.h"
+
+/*! @brief    Streams sound samples into a WAV file
+ *  @details  The file is written as 16 bit mono PCM. The sizes in the file
+ *            header are filled in when the file is closed.
+ *  @see      C64::renderAudio()
+ */
+class WAVWriter : public VC64Object {
+
+    private:
+    
+    //! @brief    The output file (NULL if no file is open)
+    FILE *file = NULL;
+    
+    //! @brief    Sample rate stored in the file header
+    uint32_t sampleRate = 0;
+    
+    //! @brief    Number of samples written so far
+    uint64_t samples = 0;
+    
+    //! @brief    Indicates that an I/O error has occurred
+    bool failed = false;
+    
+    public:
+    
+    //! @brief    Constructor
+    WAVWriter();
+    
+    //! @brief    Destructor
+    /*! @details  Closes the file if it is still open.
+     */
+    ~WAVWriter();
+    
+    /*! @brief    Creates a new WAV file and writes a preliminary header.
+     *  @return   false if the file cannot be created.
+     */
+    bool open(const char *filename, uint32_t sampleRate);
+    
+    /*! @brief    Completes the file header and closes the file.
+     *  @return   false if an I/O error has occurred while writing the file.
+     */
+    bool close();
+    
+    //! @brief    Returns true if a file is open.
+    bool isOpen() { return file != NULL; }
+    
+    //! @brief    Returns the number of samples written so far.
+    uint64_t count() { return samples; }
+    
+    //! @brief    Appends sound samples to the file.
+    void write(const short *data, size_t count);
+    
+    private:
+    
+    //! @brief    Writes the file header
+    void writeHeader(uint32_t dataSize);
+};
+
+#endif
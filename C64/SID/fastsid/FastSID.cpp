@@ -58,7 +58,7 @@ FastSID::FastSID()
     FastVoice::initWaveTables();
     
     // Initialize voices
-    voice[0].init(this, 0, &voice[3]);
+    voice[0].init(this, 0, &voice[2]);
     voice[1].init(this, 1, &voice[0]);
     voice[2].init(this, 2, &voice[1]);
 }
@@ -271,6 +271,28 @@ FastSID::poke(uint16_t addr, uint8_t value)
     latchedDataBus = value;
 }
 
+void
+FastSID::adjustSampleRate(double rate)
+{
+    // Rebase the cycle counter to keep the sample stream continuous
+    double position = executedCycles * samplesPerCycle;
+    samplesPerCycle = rate / (double)cpuFrequency;
+    executedCycles = (uint64_t)round(position / samplesPerCycle);
+}
+
+void
+FastSID::loadRegisters(const uint8_t *regs)
+{
+    reset();
+    memcpy(sidreg, regs, 0x19);
+    
+    updateInternals();
+    for (unsigned i = 0; i < 3; i++) {
+        voice[i].updateInternals(voice[i].gateBit());
+        voice[i].settleEnvelope();
+    }
+}
+
 /*! @brief   Execute SID
  *  @details Runs reSID for the specified amount of CPU cycles and writes
  *           the generated sound samples into the internal ring buffer.
@@ -287,8 +309,12 @@ FastSID::execute(uint64_t cycles)
     uint64_t shouldHave = (uint64_t)(executedCycles * samplesPerCycle);
     
     // How many sound samples are missing?
-    uint64_t numSamples = shouldHave - computedSamples;
-    computedSamples = shouldHave;
+    // Note: After a rate adjustment, shouldHave may lag behind by a sample.
+    uint64_t numSamples = 0;
+    if (shouldHave > computedSamples) {
+        numSamples = shouldHave - computedSamples;
+        computedSamples = shouldHave;
+    }
     
     // Do some consistency checking
     if (numSamples > buflength) {
@@ -297,9 +323,7 @@ FastSID::execute(uint64_t cycles)
     }
     
     // Compute missing samples
-    for (unsigned i = 0; i < numSamples; i++) {
-        buf[i] = calculateSingleSample();
-    }
+    computeSamples(buf, (unsigned)numSamples);
     
     // Write samples into ringbuffer
     bridge->writeData(buf, numSamples);
@@ -413,90 +437,112 @@ FastSID::updateInternals()
     }
 }
     
-int16_t
-FastSID::calculateSingleSample()
+void
+FastSID::computeSamples(int16_t *buf, unsigned n)
+{
+    while (n) {
+        unsigned chunk = MIN(n, blockSize);
+        computeBlock(buf, chunk);
+        buf += chunk;
+        n -= chunk;
+    }
+}
+
+void
+FastSID::computeBlock(int16_t *buf, unsigned n)
 {
-    uint32_t osc0, osc1, osc2;
+    assert(n <= blockSize);
+    
+    uint32_t counter[3][blockSize];
+    uint32_t osc[3][blockSize];
     FastVoice *v0 = &voice[0];
     FastVoice *v1 = &voice[1];
     FastVoice *v2 = &voice[2];
-    bool sync0 = false;
-    bool sync1 = false;
-    bool sync2 = false;
-    
-    // Advance wavetable counters
-    v0->waveTableCounter += v0->step;
-    v1->waveTableCounter += v1->step;
-    v2->waveTableCounter += v2->step;
-    
-    // Check for counter overflows (waveform loops)
-    if (v0->waveTableCounter < v0->step) {
-        v0->lsfr = NSHIFT(v0->lsfr, 16);
-        sync1 = v1->syncBit();
-    }
-    if (v1->waveTableCounter < v1->step) {
-        v1->lsfr = NSHIFT(v1->lsfr, 16);
-        sync2 = v2->syncBit();
-    }
-    if (v2->waveTableCounter < v2->step) {
-        v2->lsfr = NSHIFT(v2->lsfr, 16);
-        sync0 = v0->syncBit();
-    }
     
-    // Perform hard sync
-    if (sync0) {
-        v0->lsfr = NSHIFT(v0->lsfr, v0->waveTableCounter >> 28);
-        v0->waveTableCounter = 0;
-    }
-    if (sync1) {
-        v1->lsfr = NSHIFT(v1->lsfr, v1->waveTableCounter >> 28);
-        v1->waveTableCounter = 0;
-    }
-    if (sync2) {
-        v2->lsfr = NSHIFT(v2->lsfr, v2->waveTableCounter >> 28);
-        v2->waveTableCounter = 0;
+    // Advance the oscillators
+    if (v0->syncBit() || v1->syncBit() || v2->syncBit()) {
+        
+        // Hard sync couples the oscillators. Advance them sample by sample.
+        for (unsigned i = 0; i < n; i++) {
+            
+            bool sync0 = false;
+            bool sync1 = false;
+            bool sync2 = false;
+            
+            // Advance wavetable counters
+            v0->waveTableCounter += v0->step;
+            v1->waveTableCounter += v1->step;
+            v2->waveTableCounter += v2->step;
+            
+            // Check for counter overflows (waveform loops)
+            if (v0->waveTableCounter < v0->step) {
+                v0->lsfr = NSHIFT(v0->lsfr, 16);
+                sync1 = v1->syncBit();
+            }
+            if (v1->waveTableCounter < v1->step) {
+                v1->lsfr = NSHIFT(v1->lsfr, 16);
+                sync2 = v2->syncBit();
+            }
+            if (v2->waveTableCounter < v2->step) {
+                v2->lsfr = NSHIFT(v2->lsfr, 16);
+                sync0 = v0->syncBit();
+            }
+            
+            // Perform hard sync
+            if (sync0) {
+                v0->lsfr = NSHIFT(v0->lsfr, v0->waveTableCounter >> 28);
+                v0->waveTableCounter = 0;
+            }
+            if (sync1) {
+                v1->lsfr = NSHIFT(v1->lsfr, v1->waveTableCounter >> 28);
+                v1->waveTableCounter = 0;
+            }
+            if (sync2) {
+                v2->lsfr = NSHIFT(v2->lsfr, v2->waveTableCounter >> 28);
+                v2->waveTableCounter = 0;
+            }
+            
+            // Record counters and noise output
+            for (unsigned j = 0; j < 3; j++) {
+                counter[j][i] = voice[j].waveTableCounter;
+                if (voice[j].noiseSelected()) osc[j][i] = voice[j].noiseValue();
+            }
+        }
+        
+    } else {
+        
+        v0->advanceOscillator(counter[0], osc[0], n);
+        v1->advanceOscillator(counter[1], osc[1], n);
+        v2->advanceOscillator(counter[2], osc[2], n);
     }
     
-    // Advance ADSR counters
-    v0->adsr += v0->adsrInc;
-    v1->adsr += v1->adsrInc;
-    v2->adsr += v2->adsrInc;
-    
-    // Check if we need to perform state changes
-    if (v0->adsr + 0x80000000 < v0->adsrCmp + 0x80000000) {
-        v0->trigger_adsr();
-    }
-    if (v1->adsr + 0x80000000 < v1->adsrCmp + 0x80000000) {
-        v1->trigger_adsr();
-    }
-    if (v2->adsr + 0x80000000 < v2->adsrCmp + 0x80000000) {
-        v2->trigger_adsr();
-    }
+    // Run the waveform generators (voice 1 is ring modulated by voice 3)
+    v0->computeWaveform(counter[0], counter[2], osc[0], n);
+    v1->computeWaveform(counter[1], counter[0], osc[1], n);
+    v2->computeWaveform(counter[2], counter[1], osc[2], n);
     
-    // Oscillators
-    osc0 = (v0->adsr >> 16) * v0->doosc();
-    osc1 = (v1->adsr >> 16) * v1->doosc();
-    osc2 = (v2->adsr >> 16) * v2->doosc();
+    // Run the envelope generators
+    v0->computeEnvelope(osc[0], n);
+    v1->computeEnvelope(osc[1], n);
+    v2->computeEnvelope(osc[2], n);
     
     // Silence voice 3 if it is disconnected from the output
     if (voiceThreeDisconnected()) {
-        osc2 = 0;
+        memset(osc[2], 0, n * sizeof(uint32_t));
     }
     
     // Apply filter
     if (emulateFilter) {
-        v0->filterIO = ampMod1x8[(osc0 >> 22)];
-        if (filterOn(0)) v0->applyFilter();
-        osc0 = ((uint32_t)(v0->filterIO) + 0x80) << (7 + 15);
-        
-        v1->filterIO = ampMod1x8[(osc1 >> 22)];
-        if (filterOn(1)) v1->applyFilter();
-        osc1 = ((uint32_t)(v1->filterIO) + 0x80) << (7 + 15);
-        
-        v2->filterIO = ampMod1x8[(osc2 >> 22)];
-        if (filterOn(2)) v2->applyFilter();
-        osc2 = ((uint32_t)(v2->filterIO) + 0x80) << (7 + 15);
+        v0->applyFilter(osc[0], n, ampMod1x8, filterOn(0));
+        v1->applyFilter(osc[1], n, ampMod1x8, filterOn(1));
+        v2->applyFilter(osc[2], n, ampMod1x8, filterOn(2));
     }
     
-    return (int16_t)(((int32_t)((osc0 + osc1 + osc2) >> 20) - 0x600) * sidVolume() * 0.5);
+    // Mix the voices
+    const uint32_t *o0 = osc[0], *o1 = osc[1], *o2 = osc[2];
+    int32_t vol = sidVolume();
+    for (unsigned i = 0; i < n; i++) {
+        int32_t sum = (int32_t)((o0[i] + o1[i] + o2[i]) >> 20) - 0x600;
+        buf[i] = (int16_t)((sum * vol) / 2);
+    }
 }
@@ -136,14 +136,25 @@ public:
     //! Special poke function for the I/O memory range.
     void poke(uint16_t addr, uint8_t value);
     
+    /*! @brief   Reconstructs the SID state from the register contents
+     *  @details Resets FastSID, loads the registers and moves the envelopes
+     *           of all gated voices to their sustain level. This function is
+     *           called when FastSID becomes the active sound engine.
+     *  @param   regs The values of registers 0x00 to 0x18
+     */
+    void loadRegisters(const uint8_t *regs);
+    
     /*! @brief   Execute SID
      *  @details Runs reSID for the specified amount of CPU cycles and writes
      *           the generated sound samples into the internal ring buffer.
      */
     void execute(uint64_t cycles);
     
-    //! @brief   Computes a single sound sample
-    int16_t calculateSingleSample();
+    /*! @brief   Computes a number of sound samples
+     *  @details The samples are computed in blocks of at most blockSize
+     *           samples (see computeBlock()).
+     */
+    void computeSamples(int16_t *buf, unsigned n);
     
     
     //
@@ -165,6 +176,14 @@ public:
     //! Sets the sample rate
     void setSampleRate(uint32_t rate);
     
+    /*! @brief   Changes the number of samples computed per second
+     *  @details Unlike setSampleRate(), this function only changes the ratio
+     *           between computed samples and elapsed cycles. It is used by
+     *           the dynamic rate control to slightly speed up or slow down
+     *           sample production.
+     */
+    void adjustSampleRate(double rate);
+    
     //! Returns true iff audio filters should be emulated.
     bool getAudioFilter() { return emulateFilter; }
     
@@ -179,6 +198,22 @@ private:
     //! @brief   Initializes filter lookup tables
     void initFilter(int sampleRate);
     
+    //! @brief   Maximum number of samples computed by computeBlock()
+    static constexpr unsigned blockSize = 256;
+    
+    /*! @brief   Computes a block of sound samples
+     *  @details Instead of computing the samples one by one, each stage of
+     *           the sound pipeline is run for the whole block before the
+     *           next stage starts. The oscillators, the waveform lookups,
+     *           and the envelopes are computed per voice into small buffers.
+     *           Afterwards, the voices are filtered and mixed. The mixing
+     *           stage consists of simple loops the compiler vectorizes.
+     *           Because the registers don't change inside a block, the
+     *           result is the same as computing the samples one by one.
+     *  @param   n Number of samples (at most blockSize)
+     */
+    void computeBlock(int16_t *buf, unsigned n);
+    
     
     //
     //! @functiongroup Accessing device properties
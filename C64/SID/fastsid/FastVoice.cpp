@@ -363,6 +363,15 @@ FastVoice::trigger_adsr()
     }
 }
 
+void
+FastVoice::settleEnvelope()
+{
+    if (gateBit()) {
+        adsr = fastsid->sz[sustainRate()];
+        set_adsr(FASTSID_SUSTAIN);
+    }
+}
+
 uint32_t
 FastVoice::doosc()
 {
@@ -384,57 +393,228 @@ FastVoice::doosc()
 }
 
 void
-FastVoice::applyFilter()
+FastVoice::advanceOscillator(uint32_t *counter, uint32_t *wave, unsigned n)
 {
-    float sample, sample2;
+    uint32_t c = waveTableCounter;
+    uint32_t s = step;
+    uint32_t l = lsfr;
     
-    if (filterType == 0) {
-        filterIO = 0;
+    if (noiseSelected()) {
+        
+        for (unsigned i = 0; i < n; i++) {
+            c += s;
+            if (c < s) l = NSHIFT(l, 16);
+            counter[i] = c;
+            wave[i] = ((uint32_t)NVALUE(NSHIFT(l, c >> 28))) << 7;
+        }
+        waveTableCounter = c;
+        lsfr = l;
         return;
     }
     
-    if (filterType == FASTSID_BAND_PASS) {
-        filterLow += filterRef * filterDy;
-        filterRef += (filterIO - filterLow - (filterRef * filterResDy)) * filterDy;
-        filterIO = (signed char)(filterRef - filterLow / 4);
-        return;
+    // Without noise, the counters can be computed independently
+    for (unsigned i = 0; i < n; i++) {
+        counter[i] = c + (i + 1) * s;
     }
+    waveTableCounter = c + n * s;
     
-    if (filterType == FASTSID_HIGH_PASS) {
-        filterLow += filterRef * filterDy * 0.1;
-        filterRef += (filterIO - filterLow - (filterRef * filterResDy)) * filterDy;
-        sample = filterRef - (filterIO / 8);
-        sample = MAX(sample, -128);
-        sample = MIN(sample, 127);
-        filterIO = (signed char)sample;
+    // Shift the noise register once for each counter overflow
+    uint64_t overflows = ((uint64_t)c + (uint64_t)n * s) >> 32;
+    for (uint64_t i = 0; i < overflows; i++) {
+        l = NSHIFT(l, 16);
+    }
+    lsfr = l;
+}
+
+void
+FastVoice::computeWaveform(const uint32_t *counter, const uint32_t *prevCounter,
+                           uint32_t *wave, unsigned n)
+{
+    if (noiseSelected())
         return;
+    
+    if (wavetable == NULL) {
+        memset(wave, 0, n * sizeof(uint32_t));
+        return;
+    }
+    
+    const uint16_t *table = wavetable;
+    uint32_t offset = waveTableOffset;
+    
+    if (ringmod) {
+        for (unsigned i = 0; i < n; i++) {
+            uint32_t value = table[(counter[i] + offset) >> 20];
+            wave[i] = value ^ ((prevCounter[i] >> 31) * 0x7FFF);
+        }
+    } else {
+        for (unsigned i = 0; i < n; i++) {
+            wave[i] = table[(counter[i] + offset) >> 20];
+        }
+    }
+}
+
+void
+FastVoice::computeEnvelope(uint32_t *osc, unsigned n)
+{
+    unsigned i = 0;
+    
+    while (i < n) {
+        
+        uint32_t a = adsr;
+        uint32_t inc = (uint32_t)adsrInc;
+        uint32_t x = a + 0x80000000;
+        uint32_t cmp = adsrCmp + 0x80000000;
+        
+        // Determine how many samples are safe from a state change
+        uint64_t safe = 0;
+        if (x >= cmp) {
+            if (adsrInc > 0) {
+                safe = ((1ULL << 32) - x - 1) / inc;
+            } else if (adsrInc < 0) {
+                safe = (x - cmp) / (uint32_t)(-adsrInc);
+            } else {
+                safe = n;
+            }
+        }
+        
+        // Run the envelope ramp up to this point
+        unsigned m = (unsigned)MIN(safe, (uint64_t)(n - i));
+        for (unsigned j = 0; j < m; j++) {
+            osc[i + j] *= (a + (j + 1) * inc) >> 16;
+        }
+        a += m * inc;
+        i += m;
+        adsr = a;
+        
+        // Advance to the next state change sample by sample
+        for (; i < n; i++) {
+            adsr += adsrInc;
+            if (adsr + 0x80000000 < adsrCmp + 0x80000000) {
+                trigger_adsr();
+                osc[i++] *= adsr >> 16;
+                break;
+            }
+            osc[i] *= adsr >> 16;
+        }
     }
+}
+
+void
+FastVoice::applyFilter(uint32_t *osc, unsigned n, const signed char *ampMod,
+                       bool enabled)
+{
+    if (n == 0)
+        return;
+    
+    // The filter type doesn't change inside a block. Hence, we run a
+    // separate loop for each type and keep the filter state in registers.
+    signed char io = filterIO;
+    float low = filterLow;
+    float ref = filterRef;
+    float dy = filterDy;
+    float resDy = filterResDy;
+    float sample, sample2;
+    int tmp;
     
-    filterLow += filterRef * filterDy;
-    sample = filterIO;
-    sample2 = sample - filterLow;
-    int tmp = (int)sample2;
-    sample2 -= filterRef * filterResDy;
-    filterRef += sample2 * filterDy;
+    if (!enabled) {
+        
+        // Only requantize the samples
+        for (unsigned i = 0; i < n; i++) {
+            osc[i] = ((uint32_t)ampMod[osc[i] >> 22] + 0x80) << (7 + 15);
+        }
+        filterIO = (signed char)((osc[n - 1] >> (7 + 15)) - 0x80);
+        return;
+    }
     
     switch (filterType) {
             
+        case 0:
+            
+            io = 0;
+            for (unsigned i = 0; i < n; i++) {
+                osc[i] = 0x80 << (7 + 15);
+            }
+            break;
+            
+        case FASTSID_BAND_PASS:
+            
+            for (unsigned i = 0; i < n; i++) {
+                io = ampMod[osc[i] >> 22];
+                low += ref * dy;
+                ref += (io - low - (ref * resDy)) * dy;
+                io = (signed char)(ref - low / 4);
+                osc[i] = ((uint32_t)io + 0x80) << (7 + 15);
+            }
+            break;
+            
+        case FASTSID_HIGH_PASS:
+            
+            for (unsigned i = 0; i < n; i++) {
+                io = ampMod[osc[i] >> 22];
+                low += ref * dy * 0.1;
+                ref += (io - low - (ref * resDy)) * dy;
+                sample = ref - (io / 8);
+                sample = MAX(sample, -128);
+                sample = MIN(sample, 127);
+                io = (signed char)sample;
+                osc[i] = ((uint32_t)io + 0x80) << (7 + 15);
+            }
+            break;
+            
         case FASTSID_LOW_PASS:
         case FASTSID_BAND_PASS | FASTSID_LOW_PASS:
-            filterIO = (signed char)filterLow;
+            
+            for (unsigned i = 0; i < n; i++) {
+                io = ampMod[osc[i] >> 22];
+                low += ref * dy;
+                sample2 = io - low;
+                sample2 -= ref * resDy;
+                ref += sample2 * dy;
+                io = (signed char)low;
+                osc[i] = ((uint32_t)io + 0x80) << (7 + 15);
+            }
             break;
             
         case FASTSID_HIGH_PASS | FASTSID_LOW_PASS:
         case FASTSID_HIGH_PASS | FASTSID_BAND_PASS | FASTSID_LOW_PASS:
-            filterIO = (signed char)((int)(sample) - (tmp >> 1));
+            
+            for (unsigned i = 0; i < n; i++) {
+                io = ampMod[osc[i] >> 22];
+                low += ref * dy;
+                sample = io;
+                sample2 = sample - low;
+                tmp = (int)sample2;
+                sample2 -= ref * resDy;
+                ref += sample2 * dy;
+                io = (signed char)((int)(sample) - (tmp >> 1));
+                osc[i] = ((uint32_t)io + 0x80) << (7 + 15);
+            }
             break;
             
         case FASTSID_HIGH_PASS | FASTSID_BAND_PASS:
-            filterIO = (signed char)tmp;
+            
+            for (unsigned i = 0; i < n; i++) {
+                io = ampMod[osc[i] >> 22];
+                low += ref * dy;
+                sample2 = io - low;
+                tmp = (int)sample2;
+                sample2 -= ref * resDy;
+                ref += sample2 * dy;
+                io = (signed char)tmp;
+                osc[i] = ((uint32_t)io + 0x80) << (7 + 15);
+            }
             break;
             
         default:
-            assert(false); 
-            filterIO = 0;
+            assert(false);
     }
+    
+    // Flush tiny values to zero. Otherwise, the filter state decays into
+    // the denormal range when the voice falls silent, which is very slow.
+    if (fabsf(low) < 1e-20f) low = 0.0f;
+    if (fabsf(ref) < 1e-20f) ref = 0.0f;
+    
+    filterIO = io;
+    filterLow = low;
+    filterRef = ref;
 }
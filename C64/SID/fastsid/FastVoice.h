@@ -199,11 +199,56 @@ public:
     //! @brief ADSR counter triggered state change
     void trigger_adsr();
     
+    /*! @brief   Moves the envelope to the sustain level if the gate bit is set
+     *  @details Used when the voice is restored from the register contents.
+     */
+    void settleEnvelope();
+    
     // 15-bit oscillator value
     uint32_t doosc();
     
-    //! @brief Apply filter effect
-    void applyFilter();
+    //
+    // Block-based sample generation
+    //
+    
+    //! @brief   Returns true iff the noise waveform is selected exclusively
+    bool noiseSelected() { return waveform() == FASTSID_NOISE; }
+    
+    //! @brief   Returns the current value of the noise waveform
+    uint32_t noiseValue() {
+        return ((uint32_t)NVALUE(NSHIFT(lsfr, waveTableCounter >> 28))) << 7; }
+    
+    /*! @brief   Advances the oscillator by a number of samples
+     *  @details Records the counter value of each sample. If the noise
+     *           waveform is selected, its output is recorded, too. This
+     *           function must not be used if hard sync is enabled for any
+     *           voice, because the oscillators depend on each other then.
+     *  @param   counter Receives the counter values
+     *  @param   wave    Receives the waveform output (noise only)
+     */
+    void advanceOscillator(uint32_t *counter, uint32_t *wave, unsigned n);
+    
+    /*! @brief   Computes the waveform output from recorded counter values
+     *  @details Does nothing if the noise waveform is selected.
+     *  @param   counter     Counter values of this voice
+     *  @param   prevCounter Counter values of the ring modulating voice
+     *  @param   wave        Receives the waveform output
+     */
+    void computeWaveform(const uint32_t *counter, const uint32_t *prevCounter,
+                         uint32_t *wave, unsigned n);
+    
+    /*! @brief   Advances the envelope generator by a number of samples
+     *  @details Each waveform sample is multiplied with the envelope.
+     */
+    void computeEnvelope(uint32_t *osc, unsigned n);
+    
+    /*! @brief   Applies the filter effect to a number of samples
+     *  @param   ampMod  The amplifier lookup table of the owning FastSID
+     *  @param   enabled Indicates whether the voice is routed through the
+     *           filter. If false, the samples are only requantized.
+     */
+    void applyFilter(uint32_t *osc, unsigned n, const signed char *ampMod,
+                     bool enabled);
     
     //
     // Querying configuration items
@@ -27,6 +27,16 @@
 #include "sid.h"
 #include <math.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define RESID_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESID_NEON 1
+#include <arm_neon.h>
+#endif
+
 #ifndef round
 #define round(x) (x>=0.0?floor(x+0.5):ceil(x-0.5))
 #endif
@@ -34,6 +44,143 @@
 namespace reSID
 {
 
+// ----------------------------------------------------------------------------
+// FIR convolution kernels.
+// The SIMD kernels multiply 16 bit values into 32 bit products which are
+// summed up with 32 bit wrap-around, exactly like the scalar version.
+// ----------------------------------------------------------------------------
+static int convolve_scalar(const short* a, const short* b, int n)
+{
+  int out = 0;
+  for (int i = 0; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+#if RESID_X86
+__attribute__((target("sse2")))
+static int convolve_sse2(const short* a, const short* b, int n)
+{
+  __m128i acc = _mm_setzero_si128();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+  }
+
+  // Horizontal sum.
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int out = _mm_cvtsi128_si32(acc);
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+__attribute__((target("avx2")))
+static int convolve_avx2(const short* a, const short* b, int n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+  }
+
+  // Horizontal sum.
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                              _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  int out = _mm_cvtsi128_si32(sum);
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+#endif
+
+#if RESID_NEON
+static int convolve_neon(const short* a, const short* b, int n)
+{
+  int32x4_t acc = vdupq_n_s32(0);
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t va = vld1q_s16(a + i);
+    int16x8_t vb = vld1q_s16(b + i);
+    acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+    acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+  }
+
+  // Horizontal sum.
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  int out = vget_lane_s32(vpadd_s32(sum, sum), 0);
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+#endif
+
+bool SID::has_convolution_kernel(convolution_kernel kernel)
+{
+  switch (kernel) {
+  case CONVOLVE_SCALAR:
+    return true;
+#if RESID_X86
+  case CONVOLVE_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case CONVOLVE_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+#if RESID_NEON
+  case CONVOLVE_NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+bool SID::set_convolution_kernel(convolution_kernel kernel)
+{
+  if (!has_convolution_kernel(kernel)) {
+    return false;
+  }
+
+  switch (kernel) {
+#if RESID_X86
+  case CONVOLVE_SSE2:
+    convolve = convolve_sse2;
+    break;
+  case CONVOLVE_AVX2:
+    convolve = convolve_avx2;
+    break;
+#endif
+#if RESID_NEON
+  case CONVOLVE_NEON:
+    convolve = convolve_neon;
+    break;
+#endif
+  default:
+    convolve = convolve_scalar;
+    break;
+  }
+
+  this->kernel = kernel;
+  return true;
+}
+
 // ----------------------------------------------------------------------------
 // Constructor.
 // ----------------------------------------------------------------------------
@@ -48,6 +195,13 @@ SID::SID()
   fir_f_cycles_per_sample = 0;
   fir_filter_scale = 0;
 
+  // Select the fastest convolution kernel.
+  if (!set_convolution_kernel(CONVOLVE_AVX2) &&
+      !set_convolution_kernel(CONVOLVE_SSE2) &&
+      !set_convolution_kernel(CONVOLVE_NEON)) {
+    set_convolution_kernel(CONVOLVE_SCALAR);
+  }
+
   sid_model = MOS6581;
   voice[0].set_sync_source(&voice[2]);
   voice[1].set_sync_source(&voice[0]);
@@ -664,25 +818,12 @@ void SID::adjust_sampling_frequency(double sample_freq)
 
 
 // ----------------------------------------------------------------------------
-// SID clocking - delta_t cycles.
+// SID clocking - delta_t cycles, voices only.
 // ----------------------------------------------------------------------------
-void SID::clock(cycle_count delta_t)
+void SID::clock_voices(cycle_count delta_t)
 {
   int i;
 
-  // Pipelined writes on the MOS8580.
-  if (unlikely(write_pipeline) && likely(delta_t > 0)) {
-    // Step one cycle by a recursive call to ourselves.
-    write_pipeline = 0;
-    clock(1);
-    write();
-    delta_t -= 1;
-  }
-
-  if (unlikely(delta_t <= 0)) {
-    return;
-  }
-
   // Age bus value.
   bus_value_ttl -= delta_t;
   if (unlikely(bus_value_ttl <= 0)) {
@@ -747,6 +888,29 @@ void SID::clock(cycle_count delta_t)
   for (i = 0; i < 3; i++) {
     voice[i].wave.set_waveform_output(delta_t);
   }
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - delta_t cycles.
+// ----------------------------------------------------------------------------
+void SID::clock(cycle_count delta_t)
+{
+  // Pipelined writes on the MOS8580.
+  if (unlikely(write_pipeline) && likely(delta_t > 0)) {
+    // Step one cycle by a recursive call to ourselves.
+    write_pipeline = 0;
+    clock(1);
+    write();
+    delta_t -= 1;
+  }
+
+  if (unlikely(delta_t <= 0)) {
+    return;
+  }
+
+  // Clock oscillators and amplitude modulators.
+  clock_voices(delta_t);
 
   // Clock filter.
   filter.clock(delta_t, voice[0].output(), voice[1].output(), voice[2].output());
@@ -756,6 +920,67 @@ void SID::clock(cycle_count delta_t)
 }
 
 
+// ----------------------------------------------------------------------------
+// SID clocking - delta_t cycles without audio output.
+// Only the oscillators and amplitude modulators are advanced, which is all
+// that can be observed on the bus (OSC3, ENV3). The filters keep their old
+// state until audio output is resumed.
+// ----------------------------------------------------------------------------
+void SID::clock_silent(cycle_count delta_t)
+{
+  // Pipelined writes on the MOS8580.
+  if (unlikely(write_pipeline) && likely(delta_t > 0)) {
+    write_pipeline = 0;
+    clock_silent(1);
+    write();
+    delta_t -= 1;
+  }
+
+  if (unlikely(delta_t <= 0)) {
+    return;
+  }
+
+  clock_voices(delta_t);
+}
+
+
+// ----------------------------------------------------------------------------
+// Move the envelope generators of all gated voices to their sustain level.
+// This is used when the SID state is reconstructed from the register contents
+// only. Voices with the gate bit cleared keep their (released) state.
+// ----------------------------------------------------------------------------
+void SID::settle_envelopes()
+{
+  for (int i = 0; i < 3; i++) {
+    EnvelopeGenerator& envelope = voice[i].envelope;
+
+    if (!envelope.gate) {
+      continue;
+    }
+
+    reg8 level = EnvelopeGenerator::sustain_level[envelope.sustain];
+
+    envelope.state = EnvelopeGenerator::DECAY_SUSTAIN;
+    envelope.next_state = EnvelopeGenerator::DECAY_SUSTAIN;
+    envelope.state_pipeline = 0;
+    envelope.envelope_pipeline = 0;
+    envelope.exponential_pipeline = 0;
+    envelope.rate_counter = 0;
+    envelope.rate_period = EnvelopeGenerator::rate_counter_period[envelope.decay];
+    envelope.exponential_counter = 0;
+    envelope.new_exponential_counter_period = 0;
+    envelope.envelope_counter = level;
+    envelope.env3 = level;
+
+    // Exponential counter period as set while decaying to the sustain level.
+    envelope.exponential_counter_period =
+      level > 0x5d ? 1 : level > 0x36 ? 2 : level > 0x1a ? 4 :
+      level > 0x0e ? 8 : level > 0x06 ? 16 : level > 0x00 ? 30 : 1;
+    envelope.hold_zero = level == 0;
+  }
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling.
 // Fixed point arithmetics are used.
@@ -927,10 +1152,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -941,10 +1163,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -1002,10 +1221,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = convolve(sample_start, fir_start, fir_N);
 
     v >>= FIR_SHIFT;
 
@@ -31,12 +31,26 @@
 namespace reSID
 {
 
+// Implementations of the FIR convolution used by the resampling methods.
+// The fastest kernel supported by the host CPU is selected at runtime. All
+// kernels produce identical results.
+enum convolution_kernel {
+  CONVOLVE_SCALAR,
+  CONVOLVE_SSE2,
+  CONVOLVE_AVX2,
+  CONVOLVE_NEON
+};
+
 class SID
 {
 public:
   SID();
   ~SID();
 
+  static bool has_convolution_kernel(convolution_kernel kernel);
+  bool set_convolution_kernel(convolution_kernel kernel);
+  convolution_kernel get_convolution_kernel() { return kernel; }
+
   void set_chip_model(chip_model model);
   void set_voice_mask(reg4 mask);
   void enable_filter(bool enable);
@@ -49,6 +63,8 @@ public:
 
   void clock();
   void clock(cycle_count delta_t);
+  void clock_silent(cycle_count delta_t);
+  void settle_envelopes();
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
   void reset();
 
@@ -98,6 +114,7 @@ public:
 
  public:
   static double I0(double x);
+  void clock_voices(cycle_count delta_t);
   int clock_fast(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_interpolate(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
@@ -161,6 +178,10 @@ public:
 
   // FIR_RES filter tables (FIR_N*FIR_RES).
   short* fir;
+
+  // Convolution kernel.
+  convolution_kernel kernel;
+  int (*convolve)(const short* a, const short* b, int n);
 };
 
 
@@ -784,8 +784,10 @@ void
 VIC::endFrame()
 {
     // Switch active screen buffer
-    bool first = (currentScreenBuffer == screenBuffer1);
-    currentScreenBuffer = first ? screenBuffer2 : screenBuffer1;
+    if (presentFrames) {
+        bool first = (currentScreenBuffer == screenBuffer1);
+        currentScreenBuffer = first ? screenBuffer2 : screenBuffer1;
+    }
     pixelBuffer = currentScreenBuffer;
 }
 
@@ -699,6 +699,13 @@ private:
      */
     int *pixelBuffer;
     
+    /*! @brief    Indicates if finished frames are handed over to the GUI
+     *  @details  If this flag is false, endFrame() does not switch the screen
+     *            buffers and the next frame overwrites the one just drawn.
+     *            The run-ahead feature uses this to hide rolled back frames.
+     */
+    bool presentFrames = true;
+    
     /*! @brief    Z buffer
      *  @details  Depth buffering is used to determine pixel priority. In the
      *            various render routines, a color value is only retained, if it
@@ -832,6 +839,9 @@ public:
     //! @brief    Returns the currently stabel screen buffer.
     void *screenBuffer();
 
+    //! @brief    Enables or disables the screen buffer switch in endFrame().
+    void setPresentFrames(bool value) { presentFrames = value; }
+
     //! @brief    Initializes both screenBuffers
     /*! @details  This function is needed for debugging, only. It write some
      *            recognizable pattern into both buffers.
@@ -252,7 +252,7 @@ VIC::setSpritePtr(unsigned nr, uint8_t ptr)
     
     suspend();
     uint16_t addr = (VM13VM12VM11VM10() << 6) | 0x03F8 | nr;
-    c64->mem.ram[addr] = ptr;
+    c64->mem.pokeRam(addr, ptr);
     resume();
 }
 
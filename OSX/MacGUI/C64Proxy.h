@@ -51,6 +51,7 @@ struct MemoryWrapper;
 struct VicWrapper;
 struct CiaWrapper;
 struct SidBridgeWrapper;
+struct AudioMixerWrapper;
 struct KeyboardWrapper;
 struct ControlPortWrapper;
 struct IecWrapper;
@@ -141,6 +142,11 @@ struct AnyC64FileWrapper;
 - (void) setAlwaysWarp:(BOOL)b;
 - (BOOL) warpLoad;
 - (void) setWarpLoad:(BOOL)b;
+- (BOOL) fastTapeLoad;
+- (void) setFastTapeLoad:(BOOL)b;
+- (NSInteger) runAhead;
+- (void) setRunAhead:(NSInteger)frames;
+- (RunAheadInfo) runAheadInfo;
 
 // Handling snapshots
 - (BOOL) takeAutoSnapshots;
@@ -390,6 +396,8 @@ struct AnyC64FileWrapper;
     struct SidBridgeWrapper *wrapper;
 }
 
+@property (readonly) struct SidBridgeWrapper *wrapper;
+
 - (SIDInfo) getInfo;
 - (VoiceInfo) getVoiceInfo:(NSInteger)voice;
 - (void) dump;
@@ -410,6 +418,12 @@ struct AnyC64FileWrapper;
 - (double) fillLevel;
 - (NSInteger) bufferUnderflows;
 - (NSInteger) bufferOverflows;
+- (NSInteger) targetLatency;
+- (void) setTargetLatency:(NSInteger)ms;
+- (double) rateAdjustment;
+- (NSInteger) bufferCapacity;
+- (void) setBufferCapacity:(NSInteger)ms;
+- (AudioBufferStats) bufferStats;
 
 - (void) readMonoSamples:(float *)target size:(NSInteger)n;
 - (void) readStereoSamples:(float *)target1 buffer2:(float *)target2 size:(NSInteger)n;
@@ -422,6 +436,33 @@ struct AnyC64FileWrapper;
 @end
 
 
+// -----------------------------------------------------------------------------
+//                              Audio mixer proxy
+// -----------------------------------------------------------------------------
+
+@interface AudioMixerProxy : NSObject {
+    
+    struct AudioMixerWrapper *wrapper;
+}
+
+- (instancetype) initWithSampleRate:(uint32_t)rate;
+
+- (uint32_t) sampleRate;
+- (void) setSampleRate:(uint32_t)rate;
+
+- (BOOL) addSource:(SIDProxy *)sid gain:(float)gain;
+- (void) removeSource:(SIDProxy *)sid;
+- (NSInteger) numSources;
+- (float) gain:(SIDProxy *)sid;
+- (void) setGain:(SIDProxy *)sid gain:(float)gain;
+
+- (void) readMonoSamples:(float *)target size:(NSInteger)n;
+- (void) readStereoSamples:(float *)target1 buffer2:(float *)target2 size:(NSInteger)n;
+- (void) readStereoSamplesInterleaved:(float *)target size:(NSInteger)n;
+
+@end
+
+
 // -----------------------------------------------------------------------------
 //                               Keyboard proxy
 // -----------------------------------------------------------------------------
@@ -573,6 +614,10 @@ struct AnyC64FileWrapper;
 - (BOOL) hasDisk;
 - (BOOL) hasModifiedDisk;
 - (void) setModifiedDisk:(BOOL)b;
+- (BOOL) attachBackingFile:(NSString *)path type:(C64FileType)type;
+- (void) detachBackingFile;
+- (BOOL) hasBackingFile;
+- (void) writeBackDisk;
 - (void) prepareToInsert;
 - (void) insertDisk:(AnyArchiveProxy *)disk;
 - (void) prepareToEject;
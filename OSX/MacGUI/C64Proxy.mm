@@ -20,6 +20,7 @@ struct CiaWrapper { CIA *cia; };
 struct KeyboardWrapper { Keyboard *keyboard; };
 struct ControlPortWrapper { ControlPort *port; };
 struct SidBridgeWrapper { SIDBridge *sid; };
+struct AudioMixerWrapper { AudioMixer *mixer; };
 struct IecWrapper { IEC *iec; };
 struct ExpansionPortWrapper { ExpansionPort *expansionPort; };
 struct ViaWrapper { VIA6522 *via; };
@@ -565,6 +566,8 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 
 @implementation SIDProxy
 
+@synthesize wrapper;
+
 - (instancetype) initWithSID:(SIDBridge *)sid
 {
     if (self = [super init]) {
@@ -646,6 +649,30 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 {
     return wrapper->sid->bufferOverflows;
 }
+- (NSInteger) targetLatency
+{
+    return wrapper->sid->getTargetLatency();
+}
+- (void) setTargetLatency:(NSInteger)ms
+{
+    wrapper->sid->setTargetLatency((unsigned)ms);
+}
+- (double) rateAdjustment
+{
+    return wrapper->sid->getRateAdjustment();
+}
+- (NSInteger) bufferCapacity
+{
+    return wrapper->sid->getBufferCapacity();
+}
+- (void) setBufferCapacity:(NSInteger)ms
+{
+    wrapper->sid->setBufferCapacity((unsigned)ms);
+}
+- (AudioBufferStats) bufferStats
+{
+    return wrapper->sid->getBufferStats();
+}
 - (void) readMonoSamples:(float *)target size:(NSInteger)n
 {
     wrapper->sid->readMonoSamples(target, n);
@@ -674,6 +701,71 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 @end
 
 
+// -----------------------------------------------------------------------------
+//                              Audio mixer proxy
+// -----------------------------------------------------------------------------
+
+@implementation AudioMixerProxy
+
+- (instancetype) initWithSampleRate:(uint32_t)rate
+{
+    if (self = [super init]) {
+        wrapper = new AudioMixerWrapper();
+        wrapper->mixer = new AudioMixer(rate);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    delete wrapper->mixer;
+    delete wrapper;
+}
+
+- (uint32_t) sampleRate
+{
+    return wrapper->mixer->getSampleRate();
+}
+- (void) setSampleRate:(uint32_t)rate
+{
+    wrapper->mixer->setSampleRate(rate);
+}
+- (BOOL) addSource:(SIDProxy *)sid gain:(float)gain
+{
+    return wrapper->mixer->addSource([sid wrapper]->sid, gain);
+}
+- (void) removeSource:(SIDProxy *)sid
+{
+    wrapper->mixer->removeSource([sid wrapper]->sid);
+}
+- (NSInteger) numSources
+{
+    return wrapper->mixer->numSources();
+}
+- (float) gain:(SIDProxy *)sid
+{
+    return wrapper->mixer->getGain([sid wrapper]->sid);
+}
+- (void) setGain:(SIDProxy *)sid gain:(float)gain
+{
+    wrapper->mixer->setGain([sid wrapper]->sid, gain);
+}
+- (void) readMonoSamples:(float *)target size:(NSInteger)n
+{
+    wrapper->mixer->readMonoSamples(target, n);
+}
+- (void) readStereoSamples:(float *)target1 buffer2:(float *)target2 size:(NSInteger)n
+{
+    wrapper->mixer->readStereoSamples(target1, target2, n);
+}
+- (void) readStereoSamplesInterleaved:(float *)target size:(NSInteger)n
+{
+    wrapper->mixer->readStereoSamplesInterleaved(target, n);
+}
+
+@end
+
+
 //
 // IEC bus proxy
 //
@@ -1146,6 +1238,22 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 {
     wrapper->drive->setModifiedDisk(b);
 }
+- (BOOL) attachBackingFile:(NSString *)path type:(C64FileType)type
+{
+    return wrapper->drive->attachBackingFile([path UTF8String], type);
+}
+- (void) detachBackingFile
+{
+    wrapper->drive->detachBackingFile();
+}
+- (BOOL) hasBackingFile
+{
+    return wrapper->drive->hasBackingFile();
+}
+- (void) writeBackDisk
+{
+    wrapper->drive->writeBackDisk();
+}
 - (void) prepareToInsert
 {
     wrapper->drive->prepareToInsert();
@@ -1541,6 +1649,26 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 {
     wrapper->c64->setWarpLoad(b);
 }
+- (BOOL) fastTapeLoad
+{
+    return wrapper->c64->getFastTapeLoad();
+}
+- (void) setFastTapeLoad:(BOOL)b
+{
+    wrapper->c64->setFastTapeLoad(b);
+}
+- (NSInteger) runAhead
+{
+    return wrapper->c64->getRunAhead();
+}
+- (void) setRunAhead:(NSInteger)frames
+{
+    wrapper->c64->setRunAhead((unsigned)frames);
+}
+- (RunAheadInfo) runAheadInfo
+{
+    return wrapper->c64->getRunAheadInfo();
+}
 
 // Handling snapshots
 - (BOOL) takeAutoSnapshots
@@ -1603,13 +1731,15 @@ struct AnyC64FileWrapper { AnyC64File *file; };
 }
 - (NSData *)autoSnapshotData:(NSInteger)nr {
     Snapshot *snapshot = wrapper->c64->autoSnapshot((unsigned)nr);
-    return [NSData dataWithBytes: (void *)snapshot->getHeader()
-                          length: snapshot->sizeOnDisk()];
+    NSMutableData *data = [NSMutableData dataWithLength: snapshot->sizeOnDisk()];
+    snapshot->writeToBuffer((uint8_t *)[data mutableBytes]);
+    return data;
 }
 - (NSData *)userSnapshotData:(NSInteger)nr {
     Snapshot *snapshot = wrapper->c64->userSnapshot((unsigned)nr);
-    return [NSData dataWithBytes: (void *)snapshot->getHeader()
-                          length: snapshot->sizeOnDisk()];
+    NSMutableData *data = [NSMutableData dataWithLength: snapshot->sizeOnDisk()];
+    snapshot->writeToBuffer((uint8_t *)[data mutableBytes]);
+    return data;
 }
 - (unsigned char *)autoSnapshotImageData:(NSInteger)nr
 {